@@ -0,0 +1,21 @@
+# Writes a C++ source defining the contents of a file as a byte array and its size. Run in script mode:
+#   cmake -DINPUT=file -DOUTPUT=file.cpp -DSYMBOL=kName -P embed_file.cmake
+# defines `const unsigned char kName[]` and `const size_t kNameSize`.
+
+file(READ ${INPUT} content HEX)
+string(LENGTH "${content}" numDigits)
+math(EXPR size "${numDigits} / 2")
+
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${content}")
+# CMake regular expressions have no repetition counts, so the pattern for a line of 16 bytes is spelled out.
+set(line "")
+foreach(i RANGE 15)
+    string(APPEND line "0x..,")
+endforeach()
+string(REGEX REPLACE "(${line})" "\\1\n" bytes "${bytes}")
+
+file(WRITE ${OUTPUT}
+     "// Generated from ${INPUT}, do not edit.\n"
+     "#include <cstddef>\n\n"
+     "alignas(16) extern const unsigned char ${SYMBOL}[] = {\n${bytes}};\n"
+     "extern const size_t ${SYMBOL}Size = ${size};\n")
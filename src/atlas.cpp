@@ -0,0 +1,40 @@
+#include <iostream>
+
+#include "atlas.h"
+#include "trace.h"
+
+const AtlasRegion TextureAtlas::kMissingRegion_ = {0, 0, glm::vec4(0)};
+
+TextureAtlas::TextureAtlas(const Image& image, const AtlasRegions& regions)
+    : TextureAtlas(image.width, image.height, image.pixels.data(), regions) {}
+
+TextureAtlas::TextureAtlas(GLuint width, GLuint height, const GLubyte* pixels, const AtlasRegions& regions)
+    : texture_(GL_RGBA, width, height, pixels), regions_(regions) {}
+
+const AtlasRegion& TextureAtlas::region(const std::string& name) const {
+    auto region = regions_.find(name);
+    if (region == regions_.end()) {
+        std::cerr << "Texture atlas has no image " << name << "." << std::endl;
+        return kMissingRegion_;
+    }
+    return region->second;
+}
+
+TextureAtlas loadTextureAtlas(const std::string& directory) {
+    Image atlas;
+    AtlasRegions regions;
+    buildTextureAtlas(directory, atlas, regions);
+    return TextureAtlas(atlas, regions);
+}
+
+TextureAtlas loadTextureAtlas(const AssetBundle& bundle, const std::string& name) {
+    TraceScope scope("loadTextureAtlas " + name);
+    int width = 0, height = 0;
+    const unsigned char* pixels = nullptr;
+    AtlasRegions regions;
+    if (!readTextureAtlas(bundle, name, width, height, pixels, regions)) {
+        return TextureAtlas(Image(), AtlasRegions());
+    }
+    // The pixels are uploaded straight from the mapped file.
+    return TextureAtlas(width, height, pixels, regions);
+}
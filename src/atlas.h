@@ -0,0 +1,33 @@
+#ifndef TETRIS_ATLAS_H
+#define TETRIS_ATLAS_H
+
+#include <string>
+
+#include "bundle.h"
+#include "packer.h"
+#include "util.h"
+
+// A texture with several images accessible by name, drawing any of them doesn't require switching textures.
+class TextureAtlas {
+public:
+    TextureAtlas(const Image& image, const AtlasRegions& regions);
+    TextureAtlas(GLuint width, GLuint height, const GLubyte* pixels, const AtlasRegions& regions);
+
+    const Texture& texture() const { return texture_; }
+    // Returns an empty region and reports an error if the atlas has no image with this name, e.g. when it failed to
+    // load. Drawing the empty region produces nothing, so the game keeps working without the image.
+    const AtlasRegion& region(const std::string& name) const;
+
+private:
+    static const AtlasRegion kMissingRegion_;
+
+    Texture texture_;
+    AtlasRegions regions_;
+};
+
+// Builds the atlas from the PNG files in the directory with buildTextureAtlas() and uploads it.
+TextureAtlas loadTextureAtlas(const std::string& directory);
+// Loads an atlas stored by writeTextureAtlas(), its texture is uploaded without decoding anything.
+TextureAtlas loadTextureAtlas(const AssetBundle& bundle, const std::string& name);
+
+#endif  // TETRIS_ATLAS_H
@@ -0,0 +1,141 @@
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bundle.h"
+#include "serialize.h"
+#include "trace.h"
+
+const uint32_t AssetBundle::kMagic = 0x444e4254;  // "TBND"
+const uint32_t AssetBundle::kVersion = 1;
+const size_t AssetBundle::kAlignment = 16;
+
+static size_t alignOffset(size_t offset) {
+    return (offset + AssetBundle::kAlignment - 1) / AssetBundle::kAlignment * AssetBundle::kAlignment;
+}
+
+void AssetBundleWriter::add(const std::string& name, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    entries_.emplace_back(name, std::vector<char>(bytes, bytes + size));
+}
+
+bool AssetBundleWriter::write(const std::string& path) const {
+    size_t indexSize = 3 * sizeof(uint32_t);
+    for (const auto& entry : entries_) {
+        indexSize += sizeof(uint32_t) + entry.first.size() + 2 * sizeof(uint64_t);
+    }
+
+    BinaryWriter writer;
+    writer.write(AssetBundle::kMagic);
+    writer.write(AssetBundle::kVersion);
+    writer.write(static_cast<uint32_t>(entries_.size()));
+    std::vector<size_t> offsets;
+    size_t offset = alignOffset(indexSize);
+    for (const auto& entry : entries_) {
+        writer.writeString(entry.first);
+        writer.write(static_cast<uint64_t>(offset));
+        writer.write(static_cast<uint64_t>(entry.second.size()));
+        offsets.push_back(offset);
+        offset = alignOffset(offset + entry.second.size());
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(writer.data().data(), writer.data().size());
+    size_t position = writer.data().size();
+    const char padding[AssetBundle::kAlignment] = {};
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        file.write(padding, offsets[i] - position);
+        file.write(entries_[i].second.data(), entries_[i].second.size());
+        position = offsets[i] + entries_[i].second.size();
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "Failed to write asset bundle " << path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+AssetBundle::AssetBundle(const std::string& path) {
+    TraceScope scope("openAssetBundle");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open asset bundle " << path << "." << std::endl;
+        return;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+            size_ = status.st_size;
+            mapped_ = true;
+        }
+    }
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+
+    if (data_ == nullptr || !readIndex()) {
+        close();
+        std::cerr << "Asset bundle " << path << " is damaged." << std::endl;
+    }
+}
+
+AssetBundle::AssetBundle(const char* data, size_t size) : data_(data), size_(size) {
+    TraceScope scope("openAssetBundle");
+    if (!readIndex()) {
+        close();
+        std::cerr << "Embedded asset bundle is damaged." << std::endl;
+    }
+}
+
+AssetBundle::~AssetBundle() {
+    close();
+}
+
+const char* AssetBundle::find(const std::string& name, size_t& size) const {
+    auto entry = index_.find(name);
+    if (entry == index_.end()) {
+        return nullptr;
+    }
+    size = entry->second.second;
+    return data_ + entry->second.first;
+}
+
+bool AssetBundle::readIndex() {
+    BinaryReader reader(data_, size_);
+    uint32_t magic = 0, version = 0, numEntries = 0;
+    reader.read(magic);
+    reader.read(version);
+    reader.read(numEntries);
+    if (!reader.ok() || magic != kMagic || version != kVersion) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numEntries && reader.ok(); ++i) {
+        std::string name;
+        uint64_t offset = 0, size = 0;
+        reader.readString(name);
+        reader.read(offset);
+        reader.read(size);
+        if (offset > size_ || size > size_ - offset) {
+            reader.fail();
+        }
+        index_[name] = std::make_pair(static_cast<size_t>(offset), static_cast<size_t>(size));
+    }
+    return reader.ok();
+}
+
+void AssetBundle::close() {
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    index_.clear();
+}
@@ -0,0 +1,60 @@
+#ifndef TETRIS_BUNDLE_H
+#define TETRIS_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Asset bundle: a single file holding named entries of raw bytes, produced at build time by tools/pack_assets.cpp.
+// Images are stored as decoded RGBA pixels, so they are uploaded straight from the bundle without any decoding.
+//
+// Layout: magic, version, number of entries and the index of (name, offset, size), followed by the entry data, each
+// entry aligned to kAlignment bytes. Offsets are from the start of the file.
+class AssetBundleWriter {
+public:
+    void add(const std::string& name, const void* data, size_t size);
+    void add(const std::string& name, const std::vector<char>& data) { add(name, data.data(), data.size()); }
+
+    bool write(const std::string& path) const;
+
+private:
+    std::vector<std::pair<std::string, std::vector<char>>> entries_;
+};
+
+// Maps a bundle file into memory read-only, entries are accessed in place. Pages are loaded on first access, so
+// opening a bundle costs only reading the index. A bundle embedded into the executable is accessed in place as well.
+class AssetBundle {
+public:
+    static const uint32_t kMagic;
+    static const uint32_t kVersion;
+    static const size_t kAlignment;
+
+    // Prints an error and leaves the bundle closed if the file is missing or damaged.
+    explicit AssetBundle(const std::string& path);
+    // The data must outlive the bundle.
+    AssetBundle(const char* data, size_t size);
+    ~AssetBundle();
+
+    AssetBundle(const AssetBundle&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+
+    bool isOpen() const { return data_ != nullptr; }
+
+    // Returns nullptr if there is no such entry.
+    const char* find(const std::string& name, size_t& size) const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    // Offset and size of each entry.
+    std::unordered_map<std::string, std::pair<size_t, size_t>> index_;
+
+    bool readIndex();
+    void close();
+};
+
+#endif  // TETRIS_BUNDLE_H
@@ -0,0 +1,10 @@
+#ifndef TETRIS_EMBEDDED_H
+#define TETRIS_EMBEDDED_H
+
+#include <cstddef>
+
+// The asset bundle compiled into the executable by cmake/embed_file.cmake when TETRIS_EMBED_ASSETS is defined.
+extern const unsigned char kEmbeddedAssets[];
+extern const size_t kEmbeddedAssetsSize;
+
+#endif  // TETRIS_EMBEDDED_H
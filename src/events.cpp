@@ -0,0 +1,147 @@
+#include <cstring>
+#include <iostream>
+
+#include "events.h"
+
+static const char* kEventNames[] = {"spawn", "lock", "lines_cleared", "level_up", "hold", "score", "game_over"};
+static const char* kScoreReasonNames[] = {"none", "soft_drop", "hard_drop", "lines_cleared"};
+static const char* kPieceNames[] = {"I", "J", "L", "O", "S", "T", "Z"};
+
+static const char* pieceName(PieceKind kind) { return kind == kNone ? "none" : kPieceNames[kind]; }
+
+const size_t BufferedFileSink::kFlushThreshold_ = 64 * 1024;
+
+void FanOutEventSink::onEvent(const GameEvent& event) {
+    for (auto& sink : sinks_) {
+        sink->onEvent(event);
+    }
+}
+
+void FanOutEventSink::flush() {
+    for (auto& sink : sinks_) {
+        sink->flush();
+    }
+}
+
+BufferedFileSink::BufferedFileSink(const std::string& path, const char* mode) : file_(std::fopen(path.c_str(), mode)) {
+    if (file_ == nullptr) {
+        std::cerr << "Failed to open " << path << " for writing events." << std::endl;
+    }
+    buffer_.reserve(2 * kFlushThreshold_);
+    pending_.reserve(2 * kFlushThreshold_);
+    writer_ = std::thread(&BufferedFileSink::runWriter, this);
+}
+
+BufferedFileSink::~BufferedFileSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wake_.notify_one();
+    writer_.join();
+    if (file_ != nullptr) {
+        std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+        std::fclose(file_);
+    }
+}
+
+void BufferedFileSink::flush() {
+    if (buffer_.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || !pending_.empty()) {
+        return;
+    }
+    // Swapping strings exchanges their storage, nothing is copied or allocated.
+    pending_.swap(buffer_);
+    lock.unlock();
+    wake_.notify_one();
+}
+
+void BufferedFileSink::flushIfFull() {
+    if (buffer_.size() >= kFlushThreshold_) {
+        flush();
+    }
+}
+
+void BufferedFileSink::runWriter() {
+    std::string writing;
+    writing.reserve(2 * kFlushThreshold_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return !running_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            break;
+        }
+        writing.swap(pending_);
+        lock.unlock();
+        if (file_ != nullptr) {
+            std::fwrite(writing.data(), 1, writing.size(), file_);
+            std::fflush(file_);
+        }
+        writing.clear();
+        lock.lock();
+    }
+}
+
+void JsonLinesEventWriter::onEvent(const GameEvent& event) {
+    char line[256];
+    int length = std::snprintf(line, sizeof(line), R"({"event":"%s","time":%.3f,"piece_index":%u)",
+                               kEventNames[static_cast<int>(event.type)], event.time, event.pieceIndex);
+
+    switch (event.type) {
+    case EventType::kSpawn:
+    case EventType::kHold:
+        length += std::snprintf(line + length, sizeof(line) - length, R"(,"piece":"%s")", pieceName(event.piece));
+        break;
+    case EventType::kLock:
+        length += std::snprintf(line + length, sizeof(line) - length,
+                                R"(,"piece":"%s","row":%d,"col":%d,"rotation":%d)", pieceName(event.piece), event.row,
+                                event.col, event.rotation);
+        break;
+    case EventType::kLinesCleared:
+        length += std::snprintf(line + length, sizeof(line) - length, R"(,"lines":%d)", event.lines);
+        break;
+    case EventType::kLevelUp:
+        length += std::snprintf(line + length, sizeof(line) - length, R"(,"level":%d)", event.level);
+        break;
+    case EventType::kScore:
+        length += std::snprintf(line + length, sizeof(line) - length, R"(,"delta":%d,"reason":"%s","score":%d)",
+                                event.scoreDelta, kScoreReasonNames[static_cast<int>(event.reason)], event.score);
+        break;
+    case EventType::kGameOver:
+        length += std::snprintf(line + length, sizeof(line) - length, R"(,"score":%d)", event.score);
+        break;
+    }
+
+    buffer_.append(line, length);
+    buffer_.append("}\n");
+    flushIfFull();
+}
+
+const uint32_t BinaryEventWriter::kFormatVersion = 1;
+
+BinaryEventWriter::BinaryEventWriter(const std::string& path) : BufferedFileSink(path, "wb") {
+    buffer_.append("TEVT", 4);
+    buffer_.append(reinterpret_cast<const char*>(&kFormatVersion), sizeof(kFormatVersion));
+}
+
+void BinaryEventWriter::onEvent(const GameEvent& event) {
+    PackedEvent packed;
+    packed.type = static_cast<uint8_t>(event.type);
+    packed.piece = static_cast<int8_t>(event.piece);
+    packed.row = static_cast<int8_t>(event.row);
+    packed.col = static_cast<int8_t>(event.col);
+    packed.rotation = static_cast<uint8_t>(event.rotation);
+    packed.lines = static_cast<uint8_t>(event.lines);
+    packed.level = static_cast<uint8_t>(event.level);
+    packed.reason = static_cast<uint8_t>(event.reason);
+    packed.time = event.time;
+    packed.pieceIndex = event.pieceIndex;
+    packed.scoreDelta = event.scoreDelta;
+    packed.score = event.score;
+
+    buffer_.append(reinterpret_cast<const char*>(&packed), sizeof(packed));
+    flushIfFull();
+}
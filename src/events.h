@@ -0,0 +1,117 @@
+#ifndef TETRIS_EVENTS_H
+#define TETRIS_EVENTS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tetris.h"
+
+enum class EventType : uint8_t { kSpawn, kLock, kLinesCleared, kLevelUp, kHold, kScore, kGameOver };
+enum class ScoreReason : uint8_t { kNone, kSoftDrop, kHardDrop, kLinesCleared };
+
+// A single game event. Time, piece index, level and score are filled in for every event, other fields not relevant to
+// the event type are left zero.
+struct GameEvent {
+    EventType type = EventType::kSpawn;
+    double time = 0;          // Game time in seconds since the game start.
+    uint32_t pieceIndex = 0;  // Sequence number of the current piece since the game start, starting from 1.
+    PieceKind piece = kNone;
+    int row = 0, col = 0, rotation = 0;
+    int lines = 0;
+    int level = 0;
+    int scoreDelta = 0;
+    ScoreReason reason = ScoreReason::kNone;
+    int score = 0;
+};
+
+class EventSink {
+public:
+    virtual ~EventSink() = default;
+    virtual void onEvent(const GameEvent& event) = 0;
+    // Passes the events reported so far on to their destination without waiting for them to be written.
+    virtual void flush() {}
+};
+
+// Reports events to several sinks.
+class FanOutEventSink : public EventSink {
+public:
+    void add(std::unique_ptr<EventSink> sink) { sinks_.push_back(std::move(sink)); }
+    bool empty() const { return sinks_.empty(); }
+
+    void onEvent(const GameEvent& event) override;
+    void flush() override;
+
+private:
+    std::vector<std::unique_ptr<EventSink>> sinks_;
+};
+
+// Base for sinks which accumulate encoded events in memory and write them to a file in large chunks. A filled buffer is
+// swapped with the pending one of a writer thread, so emitting or flushing events from the game tick never touches the
+// file system. The swap only tries to take the lock: if the writer is busy or still has data pending, the buffer keeps
+// growing until the next attempt.
+class BufferedFileSink : public EventSink {
+public:
+    ~BufferedFileSink() override;
+
+    void flush() override;
+
+protected:
+    static const size_t kFlushThreshold_;
+
+    std::string buffer_;
+
+    BufferedFileSink(const std::string& path, const char* mode);
+    void flushIfFull();
+
+private:
+    FILE* file_;
+    std::string pending_;
+    bool running_ = true;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread writer_;
+
+    void runWriter();
+};
+
+// Writes one JSON object per line.
+class JsonLinesEventWriter : public BufferedFileSink {
+public:
+    explicit JsonLinesEventWriter(const std::string& path) : BufferedFileSink(path, "w") {}
+
+    void onEvent(const GameEvent& event) override;
+};
+
+// Writes a "TEVT" magic and a format version followed by fixed size PackedEvent records in the host byte order.
+class BinaryEventWriter : public BufferedFileSink {
+public:
+    static const uint32_t kFormatVersion;
+
+#pragma pack(push, 1)
+    struct PackedEvent {
+        uint8_t type;
+        int8_t piece;
+        int8_t row, col;
+        uint8_t rotation;
+        uint8_t lines;
+        uint8_t level;
+        uint8_t reason;
+        double time;
+        uint32_t pieceIndex;
+        int32_t scoreDelta;
+        int32_t score;
+    };
+#pragma pack(pop)
+
+    explicit BinaryEventWriter(const std::string& path);
+
+    void onEvent(const GameEvent& event) override;
+};
+
+#endif  // TETRIS_EVENTS_H
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fontatlas.h"
+#include "packer.h"
+#include "serialize.h"
+#include "trace.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+// Glyphs are rendered at kFontUpscale times the base height, their distance fields are computed at this resolution and
+// averaged down to the base one.
+static const int kFontUpscale = 4;
+static const uint32_t kFontCacheVersion = 2;
+
+struct DistanceVector {
+    int dx, dy;
+
+    int lengthSquared() const { return dx * dx + dy * dy; }
+};
+
+// Returns the distance from each pixel to the nearest seed pixel, computed by the 8-point sequential signed Euclidean
+// distance transform (8SSEDT): the offset to the nearest seed is propagated from the neighbors in two raster passes,
+// top-down and bottom-up, each going across the rows forward and backward.
+static std::vector<float> computeDistances(const std::vector<bool>& seeds, int width, int height) {
+    const int kFar = 1 << 14;
+    std::vector<DistanceVector> grid(width * height);
+    for (size_t i = 0; i < grid.size(); ++i) {
+        grid[i] = seeds[i] ? DistanceVector {0, 0} : DistanceVector {kFar, kFar};
+    }
+
+    auto compare = [&](int x, int y, int offsetX, int offsetY) {
+        int otherX = x + offsetX, otherY = y + offsetY;
+        if (otherX < 0 || otherX >= width || otherY < 0 || otherY >= height) {
+            return;
+        }
+        DistanceVector other = grid[otherY * width + otherX];
+        other.dx += offsetX;
+        other.dy += offsetY;
+        DistanceVector& current = grid[y * width + x];
+        if (other.lengthSquared() < current.lengthSquared()) {
+            current = other;
+        }
+    };
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            compare(x, y, -1, 0);
+            compare(x, y, 0, -1);
+            compare(x, y, -1, -1);
+            compare(x, y, 1, -1);
+        }
+        for (int x = width - 1; x >= 0; --x) {
+            compare(x, y, 1, 0);
+        }
+    }
+    for (int y = height - 1; y >= 0; --y) {
+        for (int x = width - 1; x >= 0; --x) {
+            compare(x, y, 1, 0);
+            compare(x, y, 0, 1);
+            compare(x, y, -1, 1);
+            compare(x, y, 1, 1);
+        }
+        for (int x = 0; x < width; ++x) {
+            compare(x, y, -1, 0);
+        }
+    }
+
+    std::vector<float> distances(grid.size());
+    for (size_t i = 0; i < grid.size(); ++i) {
+        distances[i] = std::sqrt(static_cast<float>(grid[i].lengthSquared()));
+    }
+    return distances;
+}
+
+// Converts a rendered glyph into a distance field image at the base resolution, extended by kFontSpread pixels on each
+// side. The image is white with the distance in the alpha channel.
+static Image buildDistanceField(const FT_Bitmap& bitmap) {
+    int padding = kFontSpread * kFontUpscale;
+    int width = (bitmap.width + kFontUpscale - 1) / kFontUpscale * kFontUpscale + 2 * padding;
+    int height = (bitmap.rows + kFontUpscale - 1) / kFontUpscale * kFontUpscale + 2 * padding;
+
+    std::vector<bool> inside(width * height, false);
+    for (unsigned int row = 0; row < bitmap.rows; ++row) {
+        const unsigned char* source = bitmap.buffer + row * bitmap.pitch;
+        for (unsigned int col = 0; col < bitmap.width; ++col) {
+            inside[(row + padding) * width + col + padding] = source[col] >= 128;
+        }
+    }
+    std::vector<bool> outside(inside.size());
+    for (size_t i = 0; i < inside.size(); ++i) {
+        outside[i] = !inside[i];
+    }
+    std::vector<float> toInside = computeDistances(inside, width, height);
+    std::vector<float> toOutside = computeDistances(outside, width, height);
+
+    Image image;
+    image.width = width / kFontUpscale;
+    image.height = height / kFontUpscale;
+    image.pixels.resize(4 * image.width * image.height);
+    for (int row = 0; row < image.height; ++row) {
+        for (int col = 0; col < image.width; ++col) {
+            float sum = 0;
+            for (int y = row * kFontUpscale; y < (row + 1) * kFontUpscale; ++y) {
+                for (int x = col * kFontUpscale; x < (col + 1) * kFontUpscale; ++x) {
+                    // The outline lies half way between pixels inside and outside.
+                    int i = y * width + x;
+                    sum += inside[i] ? toOutside[i] - 0.5f : 0.5f - toInside[i];
+                }
+            }
+            float distance = sum / (kFontUpscale * kFontUpscale * kFontUpscale);
+            float value = std::min(std::max(0.5f + 0.5f * distance / kFontSpread, 0.0f), 1.0f);
+
+            // Bitmap rows go from the top, image rows from the bottom.
+            unsigned char* pixel = image.pixel(col, image.height - 1 - row);
+            pixel[0] = pixel[1] = pixel[2] = 255;
+            pixel[3] = static_cast<unsigned char>(std::lround(255 * value));
+        }
+    }
+    return image;
+}
+
+// Atlas size and glyph metrics, shared by the cache file and asset bundles.
+static void writeFontIndex(BinaryWriter& writer, const Image& atlas, const std::vector<Glyph>& glyphs) {
+    writer.write(kFontGlyphHeight);
+    writer.write(kFontSpread);
+    writer.write(atlas.width);
+    writer.write(atlas.height);
+    writer.write(static_cast<uint32_t>(glyphs.size()));
+    for (const Glyph& glyph : glyphs) {
+        float values[] = {glyph.size.x,      glyph.size.y,      glyph.bearing.x,   glyph.bearing.y,
+                          glyph.advance,     glyph.imageSize.x, glyph.imageSize.y, glyph.uvRect.x,
+                          glyph.uvRect.y,    glyph.uvRect.z,    glyph.uvRect.w};
+        writer.write(values);
+    }
+}
+
+// Returns false if the index is damaged or was written with different parameters.
+static bool readFontIndex(BinaryReader& reader, int& width, int& height, std::vector<Glyph>& glyphs) {
+    int glyphHeight = 0, spread = 0;
+    uint32_t numGlyphs = 0;
+    reader.read(glyphHeight);
+    reader.read(spread);
+    reader.read(width);
+    reader.read(height);
+    reader.read(numGlyphs);
+    if (!reader.ok() || glyphHeight != kFontGlyphHeight || spread != kFontSpread || width < 0 || height < 0 ||
+        numGlyphs != 128) {
+        return false;
+    }
+
+    glyphs.resize(numGlyphs);
+    for (Glyph& glyph : glyphs) {
+        float values[11];
+        reader.read(values);
+        glyph.size = glm::vec2(values[0], values[1]);
+        glyph.bearing = glm::vec2(values[2], values[3]);
+        glyph.advance = values[4];
+        glyph.imageSize = glm::vec2(values[5], values[6]);
+        glyph.uvRect = glm::vec4(values[7], values[8], values[9], values[10]);
+    }
+    return reader.ok();
+}
+
+static void writeFontCache(const std::string& path, uint64_t fontHash, const Image& atlas,
+                           const std::vector<Glyph>& glyphs) {
+    BinaryWriter writer;
+    writer.write(fontHash);
+    writeFontIndex(writer, atlas, glyphs);
+    // The color channels are always white.
+    std::vector<unsigned char> alpha(atlas.width * atlas.height);
+    for (size_t i = 0; i < alpha.size(); ++i) {
+        alpha[i] = atlas.pixels[4 * i + 3];
+    }
+    writer.writeVector(alpha);
+    writeStateFile(path, kFontCacheVersion, writer.data());
+}
+
+// Returns false if the cache is missing or was built from a different font or with different parameters.
+static bool readFontCache(const std::string& path, uint64_t fontHash, Image& atlas, std::vector<Glyph>& glyphs) {
+    std::vector<char> payload;
+    if (!readStateFile(path, kFontCacheVersion, payload)) {
+        return false;
+    }
+
+    BinaryReader reader(payload.data(), payload.size());
+    uint64_t cachedHash = 0;
+    reader.read(cachedHash);
+    if (!reader.ok() || cachedHash != fontHash || !readFontIndex(reader, atlas.width, atlas.height, glyphs)) {
+        return false;
+    }
+    std::vector<unsigned char> alpha;
+    reader.readVector(alpha);
+    if (!reader.ok() || !reader.atEnd() || alpha.size() != static_cast<size_t>(atlas.width) * atlas.height) {
+        return false;
+    }
+
+    atlas.pixels.resize(4 * alpha.size());
+    for (size_t i = 0; i < alpha.size(); ++i) {
+        atlas.pixels[4 * i] = atlas.pixels[4 * i + 1] = atlas.pixels[4 * i + 2] = 255;
+        atlas.pixels[4 * i + 3] = alpha[i];
+    }
+    return true;
+}
+
+static std::string readFontFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.empty()) {
+        std::cerr << "Failed to read font " << path << "." << std::endl;
+    }
+    return data;
+}
+
+void buildFontAtlas(const std::string& path, Image& atlas, std::vector<Glyph>& glyphs) {
+    TraceScope scope("buildFontAtlas");
+    std::string data = readFontFile(path);
+
+    FT_Library ft;
+    FT_Init_FreeType(&ft);
+
+    FT_Face face;
+    if (FT_New_Memory_Face(ft, reinterpret_cast<const FT_Byte*>(data.data()), data.size(), 0, &face)) {
+        std::cerr << "Failed to load font " << path << "." << std::endl;
+        FT_Done_FreeType(ft);
+        glyphs.assign(128, Glyph());
+        return;
+    }
+    FT_Set_Pixel_Sizes(face, 0, kFontGlyphHeight * kFontUpscale);
+
+    std::vector<Image> images(128);
+    glyphs.assign(128, Glyph());
+    AtlasBuilder builder;
+    for (unsigned char c = 0; c < 128; c++) {
+        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
+            std::cerr << "Failed to load glyph " << c << "." << std::endl;
+            continue;
+        }
+
+        const FT_GlyphSlot slot = face->glyph;
+        Glyph& glyph = glyphs[c];
+        glyph.size = glm::vec2(slot->bitmap.width, slot->bitmap.rows) * (1.0f / kFontUpscale);
+        glyph.bearing = glm::vec2(slot->bitmap_left, slot->bitmap_top) * (1.0f / kFontUpscale);
+        glyph.advance = slot->advance.x / (64.0f * kFontUpscale);
+        if (slot->bitmap.width > 0 && slot->bitmap.rows > 0) {
+            images[c] = buildDistanceField(slot->bitmap);
+            glyph.imageSize = glm::vec2(images[c].width, images[c].height);
+            builder.add(std::to_string(c), images[c]);
+        }
+    }
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+
+    AtlasRegions regions;
+    builder.build(atlas, regions);
+    for (const auto& entry : regions) {
+        glyphs[std::stoi(entry.first)].uvRect = entry.second.uvRect;
+    }
+}
+
+void loadFontAtlas(const std::string& path, const std::string& cachePath, Image& atlas, std::vector<Glyph>& glyphs) {
+    TraceScope scope("loadFontAtlas");
+    uint64_t fontHash = hashStrings({readFontFile(path)});
+    if (!readFontCache(cachePath, fontHash, atlas, glyphs)) {
+        buildFontAtlas(path, atlas, glyphs);
+        writeFontCache(cachePath, fontHash, atlas, glyphs);
+    }
+}
+
+void writeFont(AssetBundleWriter& bundle, const std::string& name, const Image& atlas,
+               const std::vector<Glyph>& glyphs) {
+    BinaryWriter writer;
+    writeFontIndex(writer, atlas, glyphs);
+    bundle.add(name + ".index", writer.data());
+    bundle.add(name + ".rgba", atlas.pixels.data(), atlas.pixels.size());
+}
+
+bool readFont(const AssetBundle& bundle, const std::string& name, int& width, int& height,
+              const unsigned char*& pixels, std::vector<Glyph>& glyphs) {
+    size_t indexSize = 0, pixelsSize = 0;
+    const char* index = bundle.find(name + ".index", indexSize);
+    const char* data = bundle.find(name + ".rgba", pixelsSize);
+
+    BinaryReader reader(index, index != nullptr ? indexSize : 0);
+    if (index == nullptr || data == nullptr || !readFontIndex(reader, width, height, glyphs) || !reader.atEnd() ||
+        pixelsSize != 4 * static_cast<size_t>(width) * height) {
+        std::cerr << "Asset bundle has no valid font " << name << "." << std::endl;
+        return false;
+    }
+    pixels = reinterpret_cast<const unsigned char*>(data);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef TETRIS_FONTATLAS_H
+#define TETRIS_FONTATLAS_H
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "bundle.h"
+#include "image.h"
+
+// Height of the glyphs in the atlas in pixels and the distance from the outline, at which their distance fields
+// saturate.
+const int kFontGlyphHeight = 32;
+const int kFontSpread = 4;
+
+// Metrics are in pixels at kFontGlyphHeight.
+struct Glyph {
+    glm::vec2 size = glm::vec2(0);
+    glm::vec2 bearing = glm::vec2(0);
+    float advance = 0;
+    // Size of the distance field image, which extends kFontSpread pixels around the glyph.
+    glm::vec2 imageSize = glm::vec2(0);
+    // Texture coordinates of the bottom-left and top-right corners in the font texture.
+    glm::vec4 uvRect = glm::vec4(0);
+};
+
+// Renders the distance field atlas of a font file without creating a texture.
+void buildFontAtlas(const std::string& path, Image& atlas, std::vector<Glyph>& glyphs);
+
+// Generating the distance fields takes a while, so the result is stored in the cache file and loaded from it on later
+// runs, as long as the font file doesn't change. Doesn't need a GL context, so it may run in any thread.
+void loadFontAtlas(const std::string& path, const std::string& cachePath, Image& atlas, std::vector<Glyph>& glyphs);
+
+// Stores the font atlas in the entries "<name>.index" and "<name>.rgba" of an asset bundle.
+void writeFont(AssetBundleWriter& bundle, const std::string& name, const Image& atlas,
+               const std::vector<Glyph>& glyphs);
+// Finds a font stored by writeFont(), the pixels point into the bundle. Returns false and reports an error if it is
+// missing or damaged.
+bool readFont(const AssetBundle& bundle, const std::string& name, int& width, int& height,
+              const unsigned char*& pixels, std::vector<Glyph>& glyphs);
+
+#endif  // TETRIS_FONTATLAS_H
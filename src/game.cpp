@@ -1,8 +1,28 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
 #include <string>
 #include <vector>
 #include <thread>
 #include <glm/gtc/matrix_transform.hpp>
+#include "bundle.h"
+#include "embedded.h"
+#include "events.h"
+#include "headless.h"
+#include "pacer.h"
+#include "profiler.h"
 #include "render.h"
+#include "replay.h"
+#include "serialize.h"
+#include "snapshot.h"
+#include "sync.h"
+#include "thumbnail.h"
+#include "trace.h"
 
 const GLfloat kTileSize = 32;
 const GLint kBoardNumRows = 20;
@@ -18,16 +38,29 @@ const GLfloat kHudY = kMargin;
 const GLfloat kBoardX = 2 * kMargin + kHudWidth;
 const GLfloat kBoardY = kMargin;
 const GLfloat kHudPieceBoxHeight = 2.5f * kTileSize;
-const GLuint kFontSize = 18;
+const GLfloat kFontSize = 18;
+// Per frame, enough for all sprites and text with a wide margin. It grows if ever exceeded.
+const size_t kStreamRegionSize = 1 << 20;
+// Names of the tile images in TileColor order.
+const std::vector<std::string> kTileColors = {"cyan", "blue", "orange", "yellow", "green", "purple", "red"};
 
 const double kGameTimeStep = 0.005;
-const double kFps = 30;
-const double kSecondsPerFrame = 1.0 / kFps;
+const double kMaxSimulationLag = 0.25;
+const double kDefaultFps = 30;
+const int kMaxStartLevel = 15;
+
+const char* kSavePath = "tetris.sav";
+const uint32_t kSaveVersion = 2;
+const char* kShaderCacheDirectory = "shader_cache";
+// Distance field atlas generated from the font on the first run.
+const char* kFontCachePath = "kenvector_future.sdf";
+// Decoded resources produced by the pack_assets build step, used unless they are embedded into the executable.
+const char* kAssetBundlePath = "assets.bundle";
 
 Board board(kBoardNumRows, kBoardNumCols);
 Tetris* tetris;
+std::unique_ptr<EventSink> eventSink;
 
-enum GameState { kGameStart, kGameRun, kGamePaused, kGameOver };
 GameState gameState = kGameStart;
 
 bool softDrop = false;
@@ -35,14 +68,172 @@ bool moveRight = false;
 bool moveLeft = false;
 int startLevel = 1;
 
+// Off while rendering a replay, which must not touch the saved game of the player.
+bool persistGame = true;
+
+// Input is recorded by the GLFW callbacks in the main thread and applied by the simulation thread, which owns all the
+// game state above.
+SpscQueue<InputEvent, 256> inputQueue;
+
+// Toggled with F3, only used by the main thread.
+bool profilerOverlayVisible = false;
+
+void writeGameState(BinaryWriter& writer) {
+    writer.write(gameState);
+    writer.write(startLevel);
+    tetris->save(writer);
+}
+
+// Returns false if the data is damaged, the game may be left partially loaded then.
+bool readGameState(BinaryReader& reader, GameState& savedGameState, int& savedStartLevel) {
+    reader.read(savedGameState);
+    reader.read(savedStartLevel);
+    if (savedGameState < kGameStart || savedGameState > kGameOver || savedStartLevel < 1 ||
+        savedStartLevel > kMaxStartLevel) {
+        reader.fail();
+    }
+    tetris->load(reader);
+    return reader.ok() && reader.atEnd();
+}
+
+void saveGame() {
+    if (!persistGame) {
+        return;
+    }
+    BinaryWriter writer;
+    writeGameState(writer);
+    writeStateFile(kSavePath, kSaveVersion, writer.data());
+}
+
+void discardSavedGame() {
+    if (persistGame) {
+        std::remove(kSavePath);
+    }
+}
+
+bool loadGame() {
+    std::vector<char> payload;
+    if (!readStateFile(kSavePath, kSaveVersion, payload)) {
+        return false;
+    }
+
+    BinaryReader reader(payload.data(), payload.size());
+    GameState savedGameState = kGameStart;
+    int savedStartLevel = 1;
+    if (!readGameState(reader, savedGameState, savedStartLevel) ||
+        (savedGameState != kGameRun && savedGameState != kGamePaused)) {
+        tetris->restart(startLevel);
+        return false;
+    }
+
+    // Always resume into the pause screen to give the player time to get ready.
+    gameState = kGamePaused;
+    startLevel = savedStartLevel;
+    return true;
+}
+
+void pauseGame() {
+    gameState = kGamePaused;
+    saveGame();
+    if (eventSink) {
+        eventSink->flush();
+    }
+}
+
+// Values shown in the HUD, which is rendered again only when they change.
+struct HudValues {
+    int level = 0;
+    int linesCleared = 0;
+    int score = 0;
+    PieceKind nextPiece = kNone;
+    PieceKind heldPiece = kNone;
+
+    bool operator!=(const HudValues& other) const {
+        return level != other.level || linesCleared != other.linesCleared || score != other.score ||
+               nextPiece != other.nextPiece || heldPiece != other.heldPiece;
+    }
+};
+
+struct Options {
+    std::string eventsJsonlPath;
+    std::string eventsBinaryPath;
+    double fps = kDefaultFps;
+    bool vsync = false;
+    bool printPacingStats = false;
+    bool printGlStats = false;
+    std::string profileCsvPath;
+    std::string recordReplayPath;
+    std::string renderReplayPath;
+    std::string framesDirectory = ".";
+    std::string renderer = "gl";
+    int numSpectatedGames = 0;
+    std::string tracePath;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--events-jsonl" && hasValue) {
+            options.eventsJsonlPath = argv[++i];
+        } else if (arg == "--events-binary" && hasValue) {
+            options.eventsBinaryPath = argv[++i];
+        } else if (arg == "--fps" && hasValue && std::atof(argv[i + 1]) > 0) {
+            options.fps = std::atof(argv[++i]);
+        } else if (arg == "--vsync") {
+            options.vsync = true;
+        } else if (arg == "--pacing-stats") {
+            options.printPacingStats = true;
+        } else if (arg == "--gl-stats") {
+            options.printGlStats = true;
+        } else if (arg == "--profile-csv" && hasValue) {
+            options.profileCsvPath = argv[++i];
+        } else if (arg == "--record-replay" && hasValue) {
+            options.recordReplayPath = argv[++i];
+        } else if (arg == "--render-replay" && hasValue) {
+            options.renderReplayPath = argv[++i];
+        } else if (arg == "--frames-dir" && hasValue) {
+            options.framesDirectory = argv[++i];
+        } else if (arg == "--renderer" && hasValue &&
+                   (argv[i + 1] == std::string("gl") || argv[i + 1] == std::string("software") ||
+                    argv[i + 1] == std::string("null"))) {
+            options.renderer = argv[++i];
+        } else if (arg == "--spectate" && hasValue && std::atoi(argv[i + 1]) > 0 &&
+                   std::atoi(argv[i + 1]) <= BoardWallRenderer::kMaxBoards) {
+            options.numSpectatedGames = std::atoi(argv[++i]);
+        } else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--events-jsonl PATH] [--events-binary PATH] [--fps FPS | --vsync] [--pacing-stats]"
+                      << " [--gl-stats] [--profile-csv PATH] [--record-replay PATH]"
+                      << " [--render-replay PATH [--frames-dir DIR] [--renderer gl|software|null]] [--spectate N]"
+                      << " [--trace PATH]" << std::endl;
+            return false;
+        }
+    }
+
+    // Playing needs a window for input, so only replays can run without OpenGL.
+    if (options.renderer != "gl" && options.renderReplayPath.empty()) {
+        std::cerr << "The " << options.renderer << " renderer can only be used with --render-replay." << std::endl;
+        return false;
+    }
+    if (options.numSpectatedGames > 0 && !options.renderReplayPath.empty()) {
+        std::cerr << "Games can't be spectated while rendering a replay." << std::endl;
+        return false;
+    }
+    return true;
+}
+
 GLFWwindow* setupGlContext() {
+    TraceScope scope("setupGlContext");
     if (!glfwInit()) {
         return nullptr;
     }
 
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     GLFWwindow* window = glfwCreateWindow(kWidth, kHeight, "TETRIS", nullptr, nullptr);
@@ -52,12 +243,22 @@ GLFWwindow* setupGlContext() {
     }
 
     glfwMakeContextCurrent(window);
+    TraceScope glewScope("glewInit");
     glewInit();
 
     return window;
 }
 
-void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/) {
+void processInput(const InputEvent& event) {
+    if (event.type == InputEvent::kFocusLost) {
+        if (gameState == kGameRun) {
+            pauseGame();
+        }
+        return;
+    }
+
+    int key = event.key;
+    int action = event.action;
     switch (gameState) {
     case kGameRun:
         if (action == GLFW_PRESS) {
@@ -69,7 +270,7 @@ void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action,
             case GLFW_KEY_LEFT: moveLeft = true; break;
             case GLFW_KEY_RIGHT: moveRight = true; break;
             case GLFW_KEY_DOWN: softDrop = true; break;
-            case GLFW_KEY_ESCAPE: gameState = kGamePaused;
+            case GLFW_KEY_ESCAPE: pauseGame();
             }
         } else if (action == GLFW_RELEASE) {
             switch (key) {
@@ -83,6 +284,7 @@ void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action,
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
             gameState = kGameRun;
         } else if (key == GLFW_KEY_ENTER && action == GLFW_PRESS) {
+            discardSavedGame();
             gameState = kGameStart;
         }
         break;
@@ -99,260 +301,746 @@ void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action,
             tetris->restart(startLevel);
             gameState = kGameRun;
         } else if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
-            startLevel = std::min(15, startLevel + 1);
+            startLevel = std::min(kMaxStartLevel, startLevel + 1);
         } else if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
             startLevel = std::max(1, startLevel - 1);
         }
     }
 }
 
+void pushInput(InputEvent::Type type, int key, int action) {
+    InputEvent event = {type, key, action, monotonicTime()};
+    if (!inputQueue.push(event)) {
+        std::cerr << "Input queue is full, dropping input." << std::endl;
+    }
+}
+
+void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/) {
+    if (key == GLFW_KEY_F3) {
+        if (action == GLFW_PRESS) {
+            profilerOverlayVisible = !profilerOverlayVisible;
+        }
+        return;
+    }
+    if (action != GLFW_REPEAT) {
+        pushInput(InputEvent::kKey, key, action);
+    }
+}
+
 void windowFocusCallback(GLFWwindow* /*window*/, int focused) {
-    if (!focused && gameState == kGameRun) {
-        gameState = kGamePaused;
+    if (!focused) {
+        pushInput(InputEvent::kFocusLost, 0, 0);
     }
 }
 
-int main() {
-    GLFWwindow* window = setupGlContext();
+void advanceGame(double timeStep) {
+    if (gameState != kGameRun) {
+        return;
+    }
 
-    if (window == nullptr) {
+    tetris->update(softDrop, moveRight, moveLeft, timeStep);
+    if (tetris->isGameOver()) {
+        discardSavedGame();
+        gameState = kGameOver;
+    }
+}
+
+// Advances the game by exactly one time step. Inputs are applied at their offsets from the step start, which must be
+// ascending, by splitting the step. So the input timing doesn't depend on the step size and the result depends only
+// on the offsets, which makes the simulation reproducible from recorded inputs.
+void simulateStep(const std::vector<std::pair<double, InputEvent>>& inputs) {
+    double offset = 0;
+    for (const auto& input : inputs) {
+        advanceGame(input.first - offset);
+        offset = input.first;
+        processInput(input.second);
+        // Apply a new movement input right away instead of at the end of the next interval.
+        advanceGame(0);
+    }
+    advanceGame(kGameTimeStep - offset);
+}
+
+// Simulates the game in fixed time steps in real time. Inputs which happened during a step are applied at their time
+// stamps. When replay isn't null, the initial state and all applied inputs are recorded into it.
+void runSimulation(const std::atomic<bool>& running, TripleBuffer<GameSnapshot>& snapshots, bool printPacingStats,
+                   Replay* replay) {
+    Trace::setThreadName("simulation");
+    if (replay) {
+        BinaryWriter writer;
+        writeGameState(writer);
+        replay->initialState = writer.data();
+    }
+
+    FramePacer pacer(kGameTimeStep, kMaxSimulationLag);
+    std::vector<std::pair<double, InputEvent>> inputs;
+    for (uint64_t step = 0; running; ++step) {
+        double timeStepEnd = pacer.wait();
+        double timeStepStart = timeStepEnd - kGameTimeStep;
+
+        inputs.clear();
+        const InputEvent* event;
+        while ((event = inputQueue.front()) != nullptr && event->time <= timeStepEnd) {
+            double offset = std::min(std::max(event->time - timeStepStart, 0.0), kGameTimeStep);
+            inputs.emplace_back(offset, *event);
+            if (replay) {
+                replay->inputs.push_back({step, offset, *event});
+            }
+            inputQueue.pop();
+        }
+        simulateStep(inputs);
+
+        snapshots.writeBuffer().capture(gameState, startLevel, *tetris, board);
+        snapshots.publish();
+
+        if (replay) {
+            replay->numSteps = step + 1;
+        }
+    }
+
+    if (printPacingStats) {
+        std::cerr << "Game ticks: " << pacer.numWakeUps() << ", catch-ups: " << pacer.numCatchUps()
+                  << ", overruns: " << pacer.numOverruns() << ", jitter p50: " << 1e3 * pacer.jitterPercentile(50)
+                  << " ms, p99: " << 1e3 * pacer.jitterPercentile(99) << " ms, max: " << 1e3 * pacer.maxJitter()
+                  << " ms" << std::endl;
+    }
+}
+
+// Draws frames with OpenGL, the drawing itself is set up in main() where all the GL resources live. Frames go to the
+// bound framebuffer or, when an output size is given, into an offscreen layer which is read back and handed to the
+// consumer.
+class GlFrameRenderer : public FrameRenderer {
+public:
+    typedef std::function<void(const GameSnapshot&)> DrawFunction;
+
+    explicit GlFrameRenderer(DrawFunction draw) : draw_(draw) {}
+    GlFrameRenderer(DrawFunction draw, int width, int height, PixelReader::Consumer consumer)
+        : draw_(draw), target_(new RenderLayer(width, height)), reader_(new PixelReader(width, height, 3, consumer)) {}
+
+    void render(const GameSnapshot& snapshot) override {
+        if (target_) {
+            target_->begin();
+        }
+        draw_(snapshot);
+        if (reader_) {
+            reader_->read();
+        }
+    }
+
+    void finish() override {
+        if (reader_) {
+            reader_->finish();
+        }
+    }
+
+private:
+    DrawFunction draw_;
+    std::unique_ptr<RenderLayer> target_;
+    std::unique_ptr<PixelReader> reader_;
+};
+
+// Returns a consumer writing images into numbered PPM files.
+std::function<void(const Image&)> writeFrames(const std::string& framesDirectory, const std::string& prefix) {
+    int frame = 0;
+    return [=](const Image& image) mutable {
+        char number[16];
+        std::snprintf(number, sizeof(number), "_%06d.ppm", frame++);
+        writePpmImage(framesDirectory + "/" + prefix + number, image);
+    };
+}
+
+// Simulates a recorded game again step by step as fast as possible and renders it at the given frame rate of the game
+// time.
+void playReplay(const Replay& replay, double fps, FrameRenderer& renderer) {
+    GameSnapshot snapshot(board);
+    double startTime = monotonicTime();
+    int numFrames = 0;
+    double timeNextFrame = 0;
+    size_t nextInput = 0;
+    std::vector<std::pair<double, InputEvent>> inputs;
+    for (uint64_t step = 0; step < replay.numSteps; ++step) {
+        inputs.clear();
+        for (; nextInput < replay.inputs.size() && replay.inputs[nextInput].step == step; ++nextInput) {
+            inputs.emplace_back(replay.inputs[nextInput].offset, replay.inputs[nextInput].event);
+        }
+        simulateStep(inputs);
+
+        if ((step + 1) * kGameTimeStep < timeNextFrame) {
+            continue;
+        }
+        timeNextFrame += 1 / fps;
+
+        snapshot.capture(gameState, startLevel, *tetris, board);
+        renderer.render(snapshot);
+        ++numFrames;
+    }
+    renderer.finish();
+
+    std::cerr << "Played " << replay.numSteps << " steps and rendered " << numFrames << " frames in "
+              << monotonicTime() - startTime << " s." << std::endl;
+}
+
+// Plays randomly, stands in for tournament bots on the spectator wall.
+class RandomBot {
+public:
+    explicit RandomBot(unsigned int seed)
+        : board_(kBoardNumRows, kBoardNumCols), tetris_(board_, kGameTimeStep, seed), rng_(seed) {}
+
+    const Board& board() const { return board_; }
+
+    void step() {
+        if (tetris_.isGameOver()) {
+            tetris_.restart(1);
+        }
+
+        int action = std::uniform_int_distribution<int>(0, 99)(rng_);
+        if (action == 0) {
+            tetris_.rotate(Rotation::kRight);
+        } else if (action == 1) {
+            tetris_.hardDrop();
+        }
+        tetris_.update(false, action >= 2 && action < 6, action >= 6 && action < 10);
+    }
+
+private:
+    Board board_;
+    Tetris tetris_;
+    std::default_random_engine rng_;
+};
+
+// Shows games of bots side by side until the window is closed. The bots are simulated in the main thread, which catches
+// up with the clock before each frame, and all boards are drawn with a single call.
+void runSpectatorWall(GLFWwindow* window, const glm::mat4& projection, const std::vector<AtlasRegion>& tiles,
+                      const TextureAtlas& atlas, int numGames) {
+    const GLfloat kGap = 4;
+
+    // Picks the grid of boards giving the largest tiles.
+    int gridCols = 1;
+    GLfloat tileSize = 0;
+    for (int cols = 1; cols <= numGames; ++cols) {
+        int rows = (numGames + cols - 1) / cols;
+        GLfloat size = std::floor(std::min(((kWidth - kGap) / cols - kGap - 1) / kBoardNumCols,
+                                   ((kHeight - kGap) / rows - kGap - 1) / kBoardNumRows));
+        if (size > tileSize) {
+            tileSize = size;
+            gridCols = cols;
+        }
+    }
+
+    BoardWallRenderer wallRenderer(projection, kBoardNumRows, kBoardNumCols, numGames, tiles, atlas);
+    std::vector<std::unique_ptr<RandomBot>> bots;
+    std::vector<const Board*> boards;
+    unsigned int seed = static_cast<unsigned int>(monotonicTime() * 1e4);
+    for (int game = 0; game < numGames; ++game) {
+        bots.emplace_back(new RandomBot(seed + game));
+        boards.push_back(&bots.back()->board());
+        wallRenderer.setBoardRect(game, kGap + (game % gridCols) * (kBoardNumCols * tileSize + 1 + kGap),
+                                  kGap + (game / gridCols) * (kBoardNumRows * tileSize + 1 + kGap), tileSize);
+    }
+
+    glfwSwapInterval(1);
+    double timeSimulated = monotonicTime();
+    while (!glfwWindowShouldClose(window)) {
+        glfwPollEvents();
+
+        double time = monotonicTime();
+        timeSimulated = std::max(timeSimulated, time - kMaxSimulationLag);
+        for (; timeSimulated + kGameTimeStep <= time; timeSimulated += kGameTimeStep) {
+            for (auto& bot : bots) {
+                bot->step();
+            }
+        }
+
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        wallRenderer.render(boards);
+        glfwSwapBuffers(window);
+    }
+}
+
+void printGlStats(const GlState::Stats& stats) {
+    auto print = [](const char* name, const GlState::Counter& counter) {
+        std::cerr << " " << name << " " << counter.calls << " (" << counter.redundant << " redundant)";
+    };
+    std::cerr << "GL calls per frame:";
+    print("programs", stats.programs);
+    print("textures", stats.textures);
+    print("vertex arrays", stats.vertexArrays);
+    print("buffers", stats.arrayBuffers);
+    print("uniform buffers", stats.uniformBuffers);
+    print("framebuffers", stats.framebuffers);
+    print("uniforms", stats.uniforms);
+    std::cerr << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return EXIT_FAILURE;
+    }
+    TraceSession trace(options.tracePath);
+
+    std::unique_ptr<FanOutEventSink> sinks(new FanOutEventSink);
+    if (!options.eventsJsonlPath.empty()) {
+        sinks->add(std::unique_ptr<EventSink>(new JsonLinesEventWriter(options.eventsJsonlPath)));
+    }
+    if (!options.eventsBinaryPath.empty()) {
+        sinks->add(std::unique_ptr<EventSink>(new BinaryEventWriter(options.eventsBinaryPath)));
+    }
+    if (!sinks->empty()) {
+        eventSink = std::move(sinks);
+    }
+
+    // A recorded game can be rendered without a display, otherwise the game is played in a window.
+    bool headless = !options.renderReplayPath.empty();
+    Replay replay;
+    if (headless && !readReplay(options.renderReplayPath, replay)) {
         return EXIT_FAILURE;
     }
 
-    auto font = loadFont("resources/kenvector_future.ttf", kFontSize);
+    tetris = new Tetris(board, kGameTimeStep, static_cast<unsigned int>(monotonicTime() * 1e4));
+    // Attached before choosing a backend, so replays rendered without a display report their events too.
+    tetris->setEventSink(eventSink.get());
+    if (headless) {
+        persistGame = false;
+        BinaryReader reader(replay.initialState.data(), replay.initialState.size());
+        if (!readGameState(reader, gameState, startLevel)) {
+            std::cerr << "Replay " << options.renderReplayPath << " has a damaged initial state." << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        loadGame();
+    }
+
+    if (options.renderer == "software") {
+        std::vector<Image> tiles;
+        for (const std::string& color : kTileColors) {
+            tiles.push_back(loadRgbaImage("resources/tile_" + color + ".png"));
+        }
+        SoftwareFrameRenderer renderer(kTileSize, kBoardNumRows, kBoardNumCols, tiles,
+                                       writeFrames(options.framesDirectory, "board"));
+        playReplay(replay, options.fps, renderer);
+        return EXIT_SUCCESS;
+    } else if (options.renderer == "null") {
+        NullFrameRenderer renderer;
+        playReplay(replay, options.fps, renderer);
+        return EXIT_SUCCESS;
+    }
+
+    // Without the bundle, e.g. when running from the source tree, the resources are decoded from their files. Decoding
+    // doesn't need the GL context, so it runs in the background while the context is created, the font overlapping with
+    // the images. Only the texture uploads happen in this thread.
+#ifdef TETRIS_EMBED_ASSETS
+    AssetBundle bundle(reinterpret_cast<const char*>(kEmbeddedAssets), kEmbeddedAssetsSize);
+#else
+    AssetBundle bundle(kAssetBundlePath);
+#endif
+    Image fontAtlas, textureAtlas;
+    std::vector<Glyph> glyphs;
+    AtlasRegions atlasRegions;
+    std::future<void> fontDecoding, atlasDecoding;
+    if (!bundle.isOpen()) {
+        fontDecoding = std::async(std::launch::async, [&]() {
+            Trace::setThreadName("font decoder");
+            loadFontAtlas("resources/kenvector_future.ttf", kFontCachePath, fontAtlas, glyphs);
+        });
+        atlasDecoding = std::async(std::launch::async, [&]() {
+            buildTextureAtlas("resources", textureAtlas, atlasRegions);
+        });
+    }
 
-    std::vector<Texture> tileTextures, ghostTextures;
-    std::vector<std::string> colors = {"cyan", "blue", "orange", "yellow", "green", "purple", "red"};
+    GLFWwindow* window = nullptr;
+    int framebufferWidth = kWidth, framebufferHeight = kHeight;
+    if (headless) {
+        if (!createHeadlessContext()) {
+            return EXIT_FAILURE;
+        }
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+    } else {
+        window = setupGlContext();
+        if (window == nullptr) {
+            return EXIT_FAILURE;
+        }
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    }
+    Shader::setBinaryCacheDirectory(kShaderCacheDirectory);
+
+    if (!bundle.isOpen()) {
+        TraceScope scope("waitForDecoding");
+        fontDecoding.wait();
+        atlasDecoding.wait();
+    }
+    Font font = bundle.isOpen() ? loadFont(bundle, "font") : createFont(fontAtlas, glyphs);
+    TextureAtlas atlas = bundle.isOpen() ? loadTextureAtlas(bundle, "atlas") : TextureAtlas(textureAtlas, atlasRegions);
+
+    std::vector<AtlasRegion> tiles, ghostTiles;
     for (int color = kCyan; color <= kRed; ++color) {
-        std::string path = "resources/tile_" + colors[color] + ".png";
-        tileTextures.push_back(loadRgbaTexture(path));
-        path = "resources/contour_" + colors[color] + ".png";
-        ghostTextures.push_back(loadRgbaTexture(path));
-    }
-
-    Texture keyArrowLeft = loadRgbaTexture("resources/Keyboard_White_Arrow_Left.png");
-    Texture keyArrowRight = loadRgbaTexture("resources/Keyboard_White_Arrow_Right.png");
-    Texture keyArrowDown = loadRgbaTexture("resources/Keyboard_White_Arrow_Down.png");
-    Texture keyArrowUp = loadRgbaTexture("resources/Keyboard_White_Arrow_Up.png");
-    Texture keyZ = loadRgbaTexture("resources/Keyboard_White_Z.png");
-    Texture keyX = loadRgbaTexture("resources/Keyboard_White_X.png");
-    Texture keyC = loadRgbaTexture("resources/Keyboard_White_C.png");
-    Texture keySpace = loadRgbaTexture("resources/Keyboard_White_Space.png");
-    Texture keyEsc = loadRgbaTexture("resources/Keyboard_White_Esc.png");
-    Texture keyEnter = loadRgbaTexture("resources/Keyboard_White_Enter.png");
+        tiles.push_back(atlas.region("tile_" + kTileColors[color]));
+        ghostTiles.push_back(atlas.region("contour_" + kTileColors[color]));
+    }
+
+    const AtlasRegion& keyArrowLeft = atlas.region("Keyboard_White_Arrow_Left");
+    const AtlasRegion& keyArrowRight = atlas.region("Keyboard_White_Arrow_Right");
+    const AtlasRegion& keyArrowDown = atlas.region("Keyboard_White_Arrow_Down");
+    const AtlasRegion& keyArrowUp = atlas.region("Keyboard_White_Arrow_Up");
+    const AtlasRegion& keyZ = atlas.region("Keyboard_White_Z");
+    const AtlasRegion& keyX = atlas.region("Keyboard_White_X");
+    const AtlasRegion& keyC = atlas.region("Keyboard_White_C");
+    const AtlasRegion& keySpace = atlas.region("Keyboard_White_Space");
+    const AtlasRegion& keyEsc = atlas.region("Keyboard_White_Esc");
+    const AtlasRegion& keyEnter = atlas.region("Keyboard_White_Enter");
 
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    setDefaultBlending();
 
     glm::mat4 projection = glm::ortho(0.0f, kWidth, kHeight, 0.0f, -1.0f, 1.0f);
 
-    tetris = new Tetris(board, kGameTimeStep, static_cast<unsigned int>(glfwGetTime() * 1e4));
+    if (options.numSpectatedGames > 0) {
+        runSpectatorWall(window, projection, tiles, atlas, options.numSpectatedGames);
+        return EXIT_SUCCESS;
+    }
 
-    glfwSetKeyCallback(window, keyCallback);
-    glfwSetWindowFocusCallback(window, windowFocusCallback);
+    if (!headless) {
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetWindowFocusCallback(window, windowFocusCallback);
+    }
 
-    TextRenderer textRenderer(projection, font);
+    // Renderers compile their shaders when created, each compilation is traced inside this event.
+    double renderersBegin = monotonicTime();
+    StreamBuffer streamBuffer(kStreamRegionSize);
+    TextRenderer textRenderer(projection, font, streamBuffer, kFontSize);
 
     GLfloat letterHeight = textRenderer.computeHeight("A");
     GLfloat letterWidth = textRenderer.computeWidth("A");
 
-    SpriteRenderer spriteRenderer(projection);
-    PieceRenderer pieceRenderer(kTileSize, tileTextures, spriteRenderer);
-    PieceRenderer ghostRenderer(kTileSize, ghostTextures, spriteRenderer);
-    BoardRenderer boardRenderer(projection, kTileSize, kBoardX, kBoardY, kBoardNumRows, kBoardNumCols, tileTextures,
-                                spriteRenderer, pieceRenderer, ghostRenderer);
+    SpriteRenderer spriteRenderer(projection, atlas, streamBuffer);
+    PieceRenderer pieceRenderer(kTileSize, tiles, spriteRenderer);
+    PieceRenderer ghostRenderer(kTileSize, ghostTiles, spriteRenderer);
+    BoardRenderer boardRenderer(projection, kTileSize, kBoardX, kBoardY, kBoardNumRows, kBoardNumCols, tiles, atlas,
+                                pieceRenderer, ghostRenderer);
 
-    double timeLastGameUpdate = 0;
-    double timeLastRender = 0;
+    // HUD labels never change, the HUD values change a few times per game and overlay screens depend only on the game
+    // state. Each is rendered into its own layer when needed, so a frame only draws the board and composites the
+    // layers.
+    RenderLayer staticLayer(framebufferWidth, framebufferHeight);
+    RenderLayer hudLayer(framebufferWidth, framebufferHeight);
+    RenderLayer overlayLayer(framebufferWidth, framebufferHeight);
+    Trace::addEvent("createRenderers", renderersBegin, monotonicTime());
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    auto renderHud = [&](const HudValues& hud) {
+        pieceRenderer.renderInitialShapeCentered(Piece(hud.nextPiece), kHudX, std::round(kHudY + 1.5f * letterHeight),
+                                                 kHudWidth, kHudPieceBoxHeight);
+        pieceRenderer.renderInitialShapeCentered(Piece(hud.heldPiece), kHudX,
+                                                 std::round(kHudY + 2 * kHudPieceBoxHeight + 1.5f * letterHeight),
+                                                 kHudWidth, kHudPieceBoxHeight);
 
-        std::this_thread::sleep_for(std::chrono::duration<double>(timeLastGameUpdate + kGameTimeStep - glfwGetTime()));
-        if (gameState == kGameRun) {
-            tetris->update(softDrop, moveRight, moveLeft);
-            if (tetris->isGameOver()) {
-                gameState = kGameOver;
-            }
+        GLfloat y = 0.6f * kHeight + 1.4f * letterHeight;
+        textRenderer.renderCentered(std::to_string(hud.level), kHudX, y, kHudWidth, kColorBlack);
+        y += 3.9f * letterHeight;
+        textRenderer.renderCentered(std::to_string(hud.linesCleared), kHudX, y, kHudWidth, kColorBlack);
+        y += 3.9f * letterHeight;
+        textRenderer.renderCentered(std::to_string(hud.score), kHudX, y, kHudWidth, kColorBlack);
+    };
+
+    auto renderOverlay = [&](GameState state) {
+        switch (state) {
+        case kGameRun:
+            break;
+        case kGamePaused: {
+            GLfloat y = kBoardY + 0.38f * kBoardHeight;
+
+            textRenderer.renderCentered("PAUSED", kBoardX, y, kBoardWidth, kColorWhite);
+
+            y = kBoardY + 0.5f * kBoardHeight;
+            GLfloat xName = kBoardX + 0.1f * kBoardWidth;
+            GLfloat xIcon = kBoardX + 0.9f * kBoardWidth;
+
+            GLfloat dyAlignment = 0.5f * (keyArrowLeft.height - letterHeight);
+            textRenderer.render("CONTINUE", xName, y, kColorWhite);
+            spriteRenderer.render(keyEsc, xIcon - keyEsc.width, y - dyAlignment, keyEsc.width, keyEsc.height);
+
+            y += 5.5f * letterHeight;
+            textRenderer.render("START SCREEN", xName, y, kColorWhite);
+            dyAlignment = 0.75f * (keyEnter.height - letterHeight);
+            spriteRenderer.render(keyEnter, xIcon - keyEnter.width, y - dyAlignment, keyEnter.width,
+                                  keyEnter.height);
+
+            break;
         }
-        timeLastGameUpdate = glfwGetTime();
+        case kGameStart: {
+            GLfloat y = kBoardY + 0.05f * kBoardHeight;
 
-        double time = glfwGetTime();
-        if (time - timeLastRender >= kSecondsPerFrame) {
-            timeLastRender = time;
+            textRenderer.renderCentered("CONTROLS", kBoardX, y, kBoardWidth, kColorWhite);
 
-            glClearColor(1, 1, 1, 1);
-            glClear(GL_COLOR_BUFFER_BIT);
+            y += 4 * letterHeight;
 
-            textRenderer.renderCentered("NEXT", kHudX, kHudY, kHudWidth, kColorBlack);
-            textRenderer.renderCentered("HOLD", kHudX, kHudY + 2 * kHudPieceBoxHeight, kHudWidth, kColorBlack);
+            GLfloat xName = kBoardX + 0.1f * kBoardWidth;
+            GLfloat xIcon = kBoardX + 0.9f * kBoardWidth;
+            GLfloat dyAlignment = 0.5f * (keyArrowLeft.height - letterHeight);
+            GLfloat dyBetweenRows = 3.8f * letterHeight;
 
-            if (gameState != kGameStart) {
-                pieceRenderer.renderInitialShapeCentered(
-                    tetris->nextPiece(), kHudX, std::round(kHudY + 1.5f * letterHeight), kHudWidth, kHudPieceBoxHeight);
+            textRenderer.render("MOVE", xName, y, kColorWhite);
 
-                pieceRenderer.renderInitialShapeCentered(
-                    tetris->heldPiece(), kHudX, std::round(kHudY + 2 * kHudPieceBoxHeight + 1.5f * letterHeight),
-                    kHudWidth, kHudPieceBoxHeight);
-            }
+            GLfloat iconsWidth = keyArrowLeft.width + keyArrowRight.width;
+            spriteRenderer.render(keyArrowLeft, xIcon - iconsWidth, y - dyAlignment, keyArrowLeft.width,
+                                  keyArrowLeft.height);
+            spriteRenderer.render(keyArrowRight, xIcon - iconsWidth + keyArrowLeft.width, y - dyAlignment,
+                                  keyArrowLeft.width, keyArrowLeft.height);
 
-            int level, linesCleared, score;
-            if (gameState == kGameStart) {
-                level = startLevel;
-                linesCleared = 0;
-                score = 0;
-            } else {
-                level = tetris->level();
-                linesCleared = tetris->linesCleared();
-                score = tetris->score();
-            }
+            y += dyBetweenRows;
+            textRenderer.render("ROTATE", xName, y, kColorWhite);
+            iconsWidth = keyZ.width + keyX.width;
+            spriteRenderer.render(keyZ, xIcon - iconsWidth, y - dyAlignment, keyZ.width, keyZ.height);
+            spriteRenderer.render(keyX, xIcon - iconsWidth + keyZ.width, y - dyAlignment, keyX.width, keyZ.height);
+
+            y += dyBetweenRows;
+            textRenderer.render("SOFT DROP", xName, y, kColorWhite);
+            spriteRenderer.render(keyArrowDown, xIcon - keyArrowDown.width, y - dyAlignment, keyArrowDown.width,
+                                  keyArrowDown.height);
+
+            y += dyBetweenRows;
+            textRenderer.render("HARD DROP", xName, y, kColorWhite);
+            spriteRenderer.render(keySpace, xIcon - keySpace.width, y - dyAlignment, keySpace.width,
+                                  keySpace.height);
+
+            y += dyBetweenRows;
+            textRenderer.render("HOLD", xName, y, kColorWhite);
+            spriteRenderer.render(keyC, xIcon - keyC.width, y - dyAlignment, keyC.width, keyC.height);
+
+            y += dyBetweenRows;
+            textRenderer.render("PAUSE", xName, y, kColorWhite);
+            spriteRenderer.render(keyEsc, xIcon - keyEsc.width, y - dyAlignment, keyEsc.width, keyEsc.height);
+
+            y = kBoardY + 0.585f * kBoardHeight;
+            GLfloat lineWidth = textRenderer.computeWidth("USE") + keyArrowDown.width + keyArrowUp.width +
+                                2 * letterWidth + textRenderer.computeWidth("TO SELECT");
+            GLfloat x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
 
-            GLfloat y = 0.6f * kHeight;
-            textRenderer.renderCentered("LEVEL", kHudX, y, kHudWidth, kColorBlack);
-            y += 1.4f * letterHeight;
-            textRenderer.renderCentered(std::to_string(level), kHudX, y, kHudWidth, kColorBlack);
-
-            y += 2.5f * letterHeight;
-            textRenderer.renderCentered("LINES", kHudX, y, kHudWidth, kColorBlack);
-            y += 1.4f * letterHeight;
-            textRenderer.renderCentered(std::to_string(linesCleared), kHudX, y, kHudWidth, kColorBlack);
-
-            y += 2.5f * letterHeight;
-            textRenderer.renderCentered("SCORE", kHudX, y, kHudWidth, kColorBlack);
-            y += 1.4f * letterHeight;
-            textRenderer.renderCentered(std::to_string(score), kHudX, y, kHudWidth, kColorBlack);
-
-            boardRenderer.renderBackground();
-
-            switch (gameState) {
-            case kGameRun:
-                boardRenderer.renderTiles(board);
-                if (tetris->isPausedForLinesClear()) {
-                    boardRenderer.playLinesClearAnimation(board, tetris->linesClearPausePercent());
-                } else {
-                    boardRenderer.renderGhost(board.piece(), board.ghostRow(), board.pieceCol());
-                    boardRenderer.renderPiece(board.piece(), board.pieceRow(), board.pieceCol(), tetris->lockPercent());
-                }
-                break;
-            case kGamePaused: {
-                boardRenderer.renderTiles(board, 0.4);
-                boardRenderer.renderPiece(board.piece(), board.pieceRow(), board.pieceCol(), 0, 0.4);
-
-                GLfloat y = kBoardY + 0.38f * kBoardHeight;
-
-                textRenderer.renderCentered("PAUSED", kBoardX, y, kBoardWidth, kColorWhite);
-
-                y = kBoardY + 0.5f * kBoardHeight;
-                GLfloat xName = kBoardX + 0.1f * kBoardWidth;
-                GLfloat xIcon = kBoardX + 0.9f * kBoardWidth;
-
-                GLfloat dyAlignment = 0.5f * (keyArrowLeft.height - letterHeight);
-                textRenderer.render("CONTINUE", xName, y, kColorWhite);
-                spriteRenderer.render(keyEsc, xIcon - keyEsc.width, y - dyAlignment, keyEsc.width, keyEsc.height);
-
-                y += 5.5f * letterHeight;
-                textRenderer.render("START SCREEN", xName, y, kColorWhite);
-                dyAlignment = 0.75f * (keyEnter.height - letterHeight);
-                spriteRenderer.render(keyEnter, xIcon - keyEnter.width, y - dyAlignment, keyEnter.width,
-                                      keyEnter.height);
-
-                break;
+            textRenderer.render("USE", x, y, kColorWhite);
+            x += textRenderer.computeWidth("USE") + letterWidth;
+            spriteRenderer.render(keyArrowDown, x, y - dyAlignment, keyArrowDown.width, keyArrowDown.height);
+            x += keyArrowDown.width;
+            spriteRenderer.render(keyArrowUp, x, y - dyAlignment, keyArrowUp.width, keyArrowUp.height);
+            x += keyArrowUp.width + letterWidth;
+            textRenderer.render("TO SELECT", x, y, kColorWhite);
+            y += dyBetweenRows;
+            textRenderer.renderCentered("THE LEVEL", kBoardX, y, kBoardWidth, kColorWhite);
+
+            y = kBoardY + 0.8f * kBoardHeight;
+            lineWidth = textRenderer.computeWidth("PRESS") + keyEnter.width + 2 * letterWidth +
+                        textRenderer.computeWidth("TO START");
+            x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
+            dyAlignment = 0.7f * (keyEnter.height - letterHeight);
+
+            textRenderer.render("PRESS", x, y, kColorWhite);
+            x += textRenderer.computeWidth("PRESS") + letterWidth;
+            spriteRenderer.render(keyEnter, x, y - dyAlignment, keyEnter.width, keyEnter.height);
+            x += keyEnter.width + letterWidth;
+            textRenderer.render("TO START", x, y, kColorWhite);
+            break;
+        }
+        case kGameOver: {
+            GLfloat y = kBoardY + 0.4f * kBoardHeight;
+            textRenderer.renderCentered("GAME OVER", 2 * kMargin + kHudWidth, y, kBoardWidth, kColorWhite);
+
+            y = kBoardY + 0.53f * kBoardHeight;
+            GLfloat lineWidth = textRenderer.computeWidth("PRESS") + keyEnter.width + 2 * letterWidth +
+                                textRenderer.computeWidth("TO");
+            GLfloat x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
+            GLfloat dyAlignment = 0.7f * (keyEnter.height - letterHeight);
+
+            textRenderer.render("PRESS", x, y, kColorWhite);
+            x += textRenderer.computeWidth("PRESS") + letterWidth;
+            spriteRenderer.render(keyEnter, x, y - dyAlignment, keyEnter.width, keyEnter.height);
+            x += keyEnter.width + letterWidth;
+            textRenderer.render("TO", x, y, kColorWhite);
+            y += 3.5 * letterHeight;
+            textRenderer.renderCentered("CONTINUE", kBoardX, y, kBoardWidth, kColorWhite);
+        }
+        }
+    };
+
+    staticLayer.begin();
+    textRenderer.renderCentered("NEXT", kHudX, kHudY, kHudWidth, kColorBlack);
+    textRenderer.renderCentered("HOLD", kHudX, kHudY + 2 * kHudPieceBoxHeight, kHudWidth, kColorBlack);
+    GLfloat yLabel = 0.6f * kHeight;
+    textRenderer.renderCentered("LEVEL", kHudX, yLabel, kHudWidth, kColorBlack);
+    yLabel += 3.9f * letterHeight;
+    textRenderer.renderCentered("LINES", kHudX, yLabel, kHudWidth, kColorBlack);
+    yLabel += 3.9f * letterHeight;
+    textRenderer.renderCentered("SCORE", kHudX, yLabel, kHudWidth, kColorBlack);
+    textRenderer.flush();
+    staticLayer.end();
+
+    RenderProfiler profiler;
+    if (!options.profileCsvPath.empty()) {
+        profiler.openCsvLog(options.profileCsvPath);
+    }
+
+    HudValues renderedHud;
+    bool hudLayerValid = false;
+    GameState overlayState = kGameStart;
+    bool overlayLayerValid = false;
+
+    auto drawFrame = [&](const GameSnapshot& snapshot) {
+        profiler.beginFrame();
+
+        HudValues hud;
+        if (snapshot.gameState == kGameStart) {
+            hud.level = snapshot.startLevel;
+        } else {
+            hud.level = snapshot.level;
+            hud.linesCleared = snapshot.linesCleared;
+            hud.score = snapshot.score;
+            hud.nextPiece = snapshot.nextPiece.kind();
+            hud.heldPiece = snapshot.heldPiece.kind();
+        }
+
+        bool updateHud = !hudLayerValid || hud != renderedHud;
+        bool updateOverlay = !overlayLayerValid || snapshot.gameState != overlayState;
+        if (updateHud || updateOverlay) {
+            profiler.beginPass(kPassLayerUpdate);
+            if (updateHud) {
+                hudLayer.begin();
+                renderHud(hud);
+                spriteRenderer.flush();
+                textRenderer.flush();
+                hudLayer.end();
+                renderedHud = hud;
+                hudLayerValid = true;
             }
-            case kGameStart: {
-                GLfloat y = kBoardY + 0.05f * kBoardHeight;
-
-                textRenderer.renderCentered("CONTROLS", kBoardX, y, kBoardWidth, kColorWhite);
-
-                y += 4 * letterHeight;
-
-                GLfloat xName = kBoardX + 0.1f * kBoardWidth;
-                GLfloat xIcon = kBoardX + 0.9f * kBoardWidth;
-                GLfloat dyAlignment = 0.5f * (keyArrowLeft.height - letterHeight);
-                GLfloat dyBetweenRows = 3.8f * letterHeight;
-
-                textRenderer.render("MOVE", xName, y, kColorWhite);
-
-                GLfloat iconsWidth = keyArrowLeft.width + keyArrowRight.width;
-                spriteRenderer.render(keyArrowLeft, xIcon - iconsWidth, y - dyAlignment, keyArrowLeft.width,
-                                      keyArrowLeft.height);
-                spriteRenderer.render(keyArrowRight, xIcon - iconsWidth + keyArrowLeft.width, y - dyAlignment,
-                                      keyArrowLeft.width, keyArrowLeft.height);
-
-                y += dyBetweenRows;
-                textRenderer.render("ROTATE", xName, y, kColorWhite);
-                iconsWidth = keyZ.width + keyX.width;
-                spriteRenderer.render(keyZ, xIcon - iconsWidth, y - dyAlignment, keyZ.width, keyZ.height);
-                spriteRenderer.render(keyX, xIcon - iconsWidth + keyZ.width, y - dyAlignment, keyX.width, keyZ.height);
-
-                y += dyBetweenRows;
-                textRenderer.render("SOFT DROP", xName, y, kColorWhite);
-                spriteRenderer.render(keyArrowDown, xIcon - keyArrowDown.width, y - dyAlignment, keyArrowDown.width,
-                                      keyArrowDown.height);
-
-                y += dyBetweenRows;
-                textRenderer.render("HARD DROP", xName, y, kColorWhite);
-                spriteRenderer.render(keySpace, xIcon - keySpace.width, y - dyAlignment, keySpace.width,
-                                      keySpace.height);
-
-                y += dyBetweenRows;
-                textRenderer.render("HOLD", xName, y, kColorWhite);
-                spriteRenderer.render(keyC, xIcon - keyC.width, y - dyAlignment, keyC.width, keyC.height);
-
-                y += dyBetweenRows;
-                textRenderer.render("PAUSE", xName, y, kColorWhite);
-                spriteRenderer.render(keyEsc, xIcon - keyEsc.width, y - dyAlignment, keyEsc.width, keyEsc.height);
-
-                y = kBoardY + 0.585f * kBoardHeight;
-                GLfloat lineWidth = textRenderer.computeWidth("USE") + keyArrowDown.width + keyArrowUp.width +
-                                    2 * letterWidth + textRenderer.computeWidth("TO SELECT");
-                GLfloat x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
-
-                textRenderer.render("USE", x, y, kColorWhite);
-                x += textRenderer.computeWidth("USE") + letterWidth;
-                spriteRenderer.render(keyArrowDown, x, y - dyAlignment, keyArrowDown.width, keyArrowDown.height);
-                x += keyArrowDown.width;
-                spriteRenderer.render(keyArrowUp, x, y - dyAlignment, keyArrowUp.width, keyArrowUp.height);
-                x += keyArrowUp.width + letterWidth;
-                textRenderer.render("TO SELECT", x, y, kColorWhite);
-                y += dyBetweenRows;
-                textRenderer.renderCentered("THE LEVEL", kBoardX, y, kBoardWidth, kColorWhite);
-
-                y = kBoardY + 0.8f * kBoardHeight;
-                lineWidth = textRenderer.computeWidth("PRESS") + keyEnter.width + 2 * letterWidth +
-                            textRenderer.computeWidth("TO START");
-                x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
-                dyAlignment = 0.7f * (keyEnter.height - letterHeight);
-
-                textRenderer.render("PRESS", x, y, kColorWhite);
-                x += textRenderer.computeWidth("PRESS") + letterWidth;
-                spriteRenderer.render(keyEnter, x, y - dyAlignment, keyEnter.width, keyEnter.height);
-                x += keyEnter.width + letterWidth;
-                textRenderer.render("TO START", x, y, kColorWhite);
-                break;
+            if (updateOverlay) {
+                overlayLayer.begin();
+                renderOverlay(snapshot.gameState);
+                spriteRenderer.flush();
+                textRenderer.flush();
+                overlayLayer.end();
+                overlayState = snapshot.gameState;
+                overlayLayerValid = true;
             }
-            case kGameOver: {
-                boardRenderer.renderTiles(board, 0.4);
-
-                GLfloat y = kBoardY + 0.4f * kBoardHeight;
-                textRenderer.renderCentered("GAME OVER", 2 * kMargin + kHudWidth, y, kBoardWidth, kColorWhite);
-
-                y = kBoardY + 0.53f * kBoardHeight;
-                GLfloat lineWidth = textRenderer.computeWidth("PRESS") + keyEnter.width + 2 * letterWidth +
-                                    textRenderer.computeWidth("TO");
-                GLfloat x = kBoardX + 0.5f * (kBoardWidth - lineWidth);
-                GLfloat dyAlignment = 0.7f * (keyEnter.height - letterHeight);
-
-                textRenderer.render("PRESS", x, y, kColorWhite);
-                x += textRenderer.computeWidth("PRESS") + letterWidth;
-                spriteRenderer.render(keyEnter, x, y - dyAlignment, keyEnter.width, keyEnter.height);
-                x += keyEnter.width + letterWidth;
-                textRenderer.render("TO", x, y, kColorWhite);
-                y += 3.5 * letterHeight;
-                textRenderer.renderCentered("CONTINUE", kBoardX, y, kBoardWidth, kColorWhite);
+            profiler.endPass();
+        }
+
+        glClearColor(1, 1, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        profiler.beginPass(kPassLayers);
+        staticLayer.draw();
+        hudLayer.draw();
+        profiler.endPass();
+
+        profiler.beginPass(kPassBoard);
+        switch (snapshot.gameState) {
+        case kGameRun:
+            if (snapshot.pausedForLinesClear) {
+                boardRenderer.render(snapshot.board, 1, snapshot.linesClearPausePercent);
+            } else {
+                boardRenderer.render(snapshot.board);
+                boardRenderer.renderGhost(snapshot.board.piece(), snapshot.board.ghostRow(),
+                                          snapshot.board.pieceCol());
+                boardRenderer.renderPiece(snapshot.board.piece(), snapshot.board.pieceRow(),
+                                          snapshot.board.pieceCol(), snapshot.lockPercent);
             }
+            break;
+        case kGamePaused:
+            boardRenderer.render(snapshot.board, 0.4);
+            boardRenderer.renderPiece(snapshot.board.piece(), snapshot.board.pieceRow(), snapshot.board.pieceCol(),
+                                      0, 0.4);
+            break;
+        case kGameOver:
+            boardRenderer.render(snapshot.board, 0.4);
+            break;
+        case kGameStart:
+            // Only the background and the grid.
+            boardRenderer.render(snapshot.board, 0);
+            break;
+        }
+        profiler.endPass();
+
+        profiler.beginPass(kPassSprites);
+        spriteRenderer.flush();
+        profiler.endPass();
+
+        if (snapshot.gameState != kGameRun) {
+            profiler.beginPass(kPassOverlay);
+            overlayLayer.draw();
+            profiler.endPass();
+        }
+
+        if (profilerOverlayVisible) {
+            profiler.beginPass(kPassProfiler);
+            profiler.renderOverlay(textRenderer, kBoardX + 0.5f * letterWidth, kBoardY + 0.5f * letterHeight,
+                                   kColorWhite);
+            textRenderer.flush();
+            profiler.endPass();
+        }
+
+        profiler.endFrame();
+        streamBuffer.endFrame();
+    };
+
+    if (headless) {
+        GlFrameRenderer renderer(drawFrame, kWidth, kHeight, writeFrames(options.framesDirectory, "frame"));
+        playReplay(replay, options.fps, renderer);
+        return EXIT_SUCCESS;
+    }
+    GlFrameRenderer renderer(drawFrame);
+
+    GameSnapshot initialSnapshot(board);
+    initialSnapshot.capture(gameState, startLevel, *tetris, board);
+    TripleBuffer<GameSnapshot> snapshots(initialSnapshot);
+
+    std::atomic<bool> running(true);
+    Replay recording;
+    std::thread simulationThread(runSimulation, std::cref(running), std::ref(snapshots), options.printPacingStats,
+                                 options.recordReplayPath.empty() ? nullptr : &recording);
+
+    // With vsync the frame rate is limited by glfwSwapBuffers, otherwise frames are started at fixed deadlines and
+    // input is dispatched while waiting for them, so it is time stamped without delay.
+    glfwSwapInterval(options.vsync ? 1 : 0);
+    double secondsPerFrame = 1.0 / options.fps;
+    double timeNextRender = monotonicTime();
+    double timeNextGlStats = timeNextRender + 1;
+    bool firstFrame = true;
+
+    while (!glfwWindowShouldClose(window)) {
+        glfwPollEvents();
+        if (!options.vsync) {
+            double timeToRender;
+            while ((timeToRender = timeNextRender - monotonicTime()) > 0) {
+                glfwWaitEventsTimeout(timeToRender);
             }
+            timeNextRender = std::max(timeNextRender + secondsPerFrame, monotonicTime());
+        }
+        snapshots.update();
+        if (firstFrame) {
+            // The driver defers some work until the first frame is presented, which belongs to startup.
+            TraceScope scope("firstFrame");
+            renderer.render(snapshots.readBuffer());
+            TraceScope swapScope("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+            firstFrame = false;
+        } else {
+            renderer.render(snapshots.readBuffer());
             glfwSwapBuffers(window);
         }
+
+        if (options.printGlStats && monotonicTime() >= timeNextGlStats) {
+            printGlStats(profiler.frameGlStats());
+            timeNextGlStats += 1;
+        }
+    }
+
+    // Everything from here, including the destruction of GL objects on return, is traced as shutdown.
+    trace.beginShutdown();
+    running = false;
+    {
+        TraceScope scope("joinSimulationThread");
+        simulationThread.join();
+    }
+
+    if (!options.recordReplayPath.empty()) {
+        TraceScope scope("writeReplay");
+        writeReplay(options.recordReplayPath, recording);
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,159 @@
+#include <cassert>
+
+#include "glstate.h"
+
+GLuint GlState::program_ = 0;
+GLuint GlState::textures_[kNumTextureUnits_] = {};
+GLuint GlState::textureArrays_[kNumTextureUnits_] = {};
+GLuint GlState::activeTextureUnit_ = 0;
+GLuint GlState::vertexArray_ = 0;
+GLuint GlState::arrayBuffer_ = 0;
+GLuint GlState::uniformBuffer_ = 0;
+GLuint GlState::framebuffer_ = 0;
+GlState::Stats GlState::stats_;
+
+// Returns true if the binding needs to be changed.
+static bool updateBinding(GLuint& bound, GLuint object, GlState::Counter& counter) {
+    ++counter.calls;
+    if (bound == object) {
+        ++counter.redundant;
+        return false;
+    }
+    bound = object;
+    return true;
+}
+
+void GlState::useProgram(GLuint program) {
+    if (updateBinding(program_, program, stats_.programs)) {
+        glUseProgram(program);
+    }
+}
+
+void GlState::bindTexture(GLuint texture, GLuint unit) {
+    assert(unit < kNumTextureUnits_);
+    // The unit is activated even if the texture is already bound, so uploads after the call go to this texture.
+    activateTextureUnit(unit);
+    if (updateBinding(textures_[unit], texture, stats_.textures)) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+}
+
+void GlState::bindTextureArray(GLuint texture, GLuint unit) {
+    assert(unit < kNumTextureUnits_);
+    // The unit is activated even if the texture is already bound, so uploads after the call go to this texture.
+    activateTextureUnit(unit);
+    if (updateBinding(textureArrays_[unit], texture, stats_.textures)) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    }
+}
+
+void GlState::activateTextureUnit(GLuint unit) {
+    if (unit != activeTextureUnit_) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeTextureUnit_ = unit;
+    }
+}
+
+void GlState::bindVertexArray(GLuint vertexArray) {
+    if (updateBinding(vertexArray_, vertexArray, stats_.vertexArrays)) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void GlState::bindArrayBuffer(GLuint buffer) {
+    if (updateBinding(arrayBuffer_, buffer, stats_.arrayBuffers)) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+}
+
+void GlState::bindUniformBuffer(GLuint buffer) {
+    if (updateBinding(uniformBuffer_, buffer, stats_.uniformBuffers)) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    }
+}
+
+void GlState::bindFramebuffer(GLuint framebuffer) {
+    if (updateBinding(framebuffer_, framebuffer, stats_.framebuffers)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void GlState::countUniformUpdate(bool redundant) {
+    ++stats_.uniforms.calls;
+    if (redundant) {
+        ++stats_.uniforms.redundant;
+    }
+}
+
+GLuint GlState::createTexture() {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    return texture;
+}
+
+GLuint GlState::createVertexArray() {
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    return vertexArray;
+}
+
+GLuint GlState::createBuffer() {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    return buffer;
+}
+
+GLuint GlState::createFramebuffer() {
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    return framebuffer;
+}
+
+void GlState::deleteProgram(GLuint program) {
+    glDeleteProgram(program);
+    if (program_ == program) {
+        program_ = 0;
+    }
+}
+
+void GlState::deleteTexture(GLuint texture) {
+    glDeleteTextures(1, &texture);
+    for (GLuint unit = 0; unit < kNumTextureUnits_; ++unit) {
+        if (textures_[unit] == texture) {
+            textures_[unit] = 0;
+        }
+        if (textureArrays_[unit] == texture) {
+            textureArrays_[unit] = 0;
+        }
+    }
+}
+
+void GlState::deleteVertexArray(GLuint vertexArray) {
+    glDeleteVertexArrays(1, &vertexArray);
+    if (vertexArray_ == vertexArray) {
+        vertexArray_ = 0;
+    }
+}
+
+void GlState::deleteBuffer(GLuint buffer) {
+    glDeleteBuffers(1, &buffer);
+    if (arrayBuffer_ == buffer) {
+        arrayBuffer_ = 0;
+    }
+    if (uniformBuffer_ == buffer) {
+        uniformBuffer_ = 0;
+    }
+}
+
+void GlState::deleteFramebuffer(GLuint framebuffer) {
+    glDeleteFramebuffers(1, &framebuffer);
+    if (framebuffer_ == framebuffer) {
+        framebuffer_ = 0;
+    }
+}
+
+GlState::Stats GlState::takeStats() {
+    Stats stats = stats_;
+    stats_ = Stats();
+    return stats;
+}
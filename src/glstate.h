@@ -0,0 +1,120 @@
+#ifndef TETRIS_GLSTATE_H
+#define TETRIS_GLSTATE_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Remembers which GL objects are bound and skips binds that wouldn't change anything. All binds of programs, textures,
+// vertex arrays, array and uniform buffers and framebuffers must go through it to keep the cached state valid. Only a
+// single context is supported. Textures are bound to the GL_TEXTURE_2D target, texture arrays to GL_TEXTURE_2D_ARRAY.
+// Binding a texture also makes its unit active, so it can be updated with glTexSubImage right after.
+class GlState {
+public:
+    struct Counter {
+        unsigned int calls = 0;
+        unsigned int redundant = 0;
+    };
+
+    struct Stats {
+        Counter programs;
+        Counter textures;
+        Counter vertexArrays;
+        Counter arrayBuffers;
+        Counter uniformBuffers;
+        Counter framebuffers;
+        Counter uniforms;
+        unsigned int drawCalls = 0;
+        size_t uploadedBytes = 0;
+    };
+
+    static void useProgram(GLuint program);
+    static void bindTexture(GLuint texture, GLuint unit = 0);
+    static void bindTextureArray(GLuint texture, GLuint unit = 0);
+    static void bindVertexArray(GLuint vertexArray);
+    static void bindArrayBuffer(GLuint buffer);
+    // Binds to the generic GL_UNIFORM_BUFFER target, glBindBufferBase must only be called right after it with the same
+    // buffer, as it changes the generic binding too.
+    static void bindUniformBuffer(GLuint buffer);
+    static void bindFramebuffer(GLuint framebuffer);
+    static GLuint boundFramebuffer() { return framebuffer_; }
+
+    // Uniform values are cached by Shader, which reports whether the update was skipped.
+    static void countUniformUpdate(bool redundant);
+    // Draws and buffer or texture uploads aren't tracked state, they are only counted for profiling.
+    static void countDrawCall() { ++stats_.drawCalls; }
+    static void countUpload(size_t bytes) { stats_.uploadedBytes += bytes; }
+
+    // Objects are created and deleted through these functions, usually by GlObject. Deleting an object also forgets its
+    // bindings, as GL may reuse its name.
+    static GLuint createProgram() { return glCreateProgram(); }
+    static GLuint createTexture();
+    static GLuint createVertexArray();
+    static GLuint createBuffer();
+    static GLuint createFramebuffer();
+    static void deleteProgram(GLuint program);
+    static void deleteTexture(GLuint texture);
+    static void deleteVertexArray(GLuint vertexArray);
+    static void deleteBuffer(GLuint buffer);
+    static void deleteFramebuffer(GLuint framebuffer);
+
+    // Returns the counters accumulated since the previous call, supposed to be called once per frame.
+    static Stats takeStats();
+
+private:
+    static const GLuint kNumTextureUnits_ = 4;
+
+    static GLuint program_, vertexArray_, arrayBuffer_, uniformBuffer_, framebuffer_;
+    static GLuint textures_[kNumTextureUnits_];
+    static GLuint textureArrays_[kNumTextureUnits_];
+    static GLuint activeTextureUnit_;
+    static Stats stats_;
+
+    static void activateTextureUnit(GLuint unit);
+};
+
+// Owns a GL object and deletes it on destruction. It can be moved but not copied, so each object is deleted exactly
+// once and classes holding GL objects become move-only as well.
+template <GLuint (*Create)(), void (*Delete)(GLuint)>
+class GlObject {
+public:
+    GlObject() = default;
+    GlObject(GlObject&& other) : id_(other.id_) { other.id_ = 0; }
+    GlObject& operator=(GlObject&& other) {
+        if (this != &other) {
+            reset();
+            id_ = other.id_;
+            other.id_ = 0;
+        }
+        return *this;
+    }
+    GlObject(const GlObject&) = delete;
+    GlObject& operator=(const GlObject&) = delete;
+    ~GlObject() { reset(); }
+
+    static GlObject create() {
+        GlObject object;
+        object.id_ = Create();
+        return object;
+    }
+
+    GLuint id() const { return id_; }
+
+    void reset() {
+        if (id_ != 0) {
+            Delete(id_);
+            id_ = 0;
+        }
+    }
+
+private:
+    GLuint id_ = 0;
+};
+
+typedef GlObject<GlState::createProgram, GlState::deleteProgram> GlProgram;
+typedef GlObject<GlState::createTexture, GlState::deleteTexture> GlTexture;
+typedef GlObject<GlState::createVertexArray, GlState::deleteVertexArray> GlVertexArray;
+typedef GlObject<GlState::createBuffer, GlState::deleteBuffer> GlBuffer;
+typedef GlObject<GlState::createFramebuffer, GlState::deleteFramebuffer> GlFramebuffer;
+
+#endif  // TETRIS_GLSTATE_H
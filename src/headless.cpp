@@ -0,0 +1,138 @@
+#include <cstring>
+#include <iostream>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "headless.h"
+#include "trace.h"
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+static void destroyContext() {
+    if (display == EGL_NO_DISPLAY) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+    }
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+}
+
+bool createHeadlessContext() {
+    TraceScope scope("createHeadlessContext");
+    auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "EGL surfaceless platform is not available." << std::endl;
+        return false;
+    }
+
+    // The surfaceless platform only has pbuffer configs, they are never used to create a surface though.
+    const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                       EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0 ||
+        !eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "No suitable EGL config for OpenGL." << std::endl;
+        destroyContext();
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Failed to create a surfaceless OpenGL 3.3 context." << std::endl;
+        destroyContext();
+        return false;
+    }
+
+    // GLEW loads the GL functions first and then fails to find a GLX display, which isn't needed here.
+    GLenum error;
+    {
+        TraceScope scope("glewInit");
+        error = glewInit();
+    }
+    if (error != GLEW_OK && error != GLEW_ERROR_NO_GLX_DISPLAY) {
+        std::cerr << "Failed to initialize GLEW: " << glewGetErrorString(error) << std::endl;
+        destroyContext();
+        return false;
+    }
+
+    return true;
+}
+
+PixelReader::PixelReader(int width, int height, int numBuffers, Consumer consumer)
+    : width_(width), height_(height), buffers_(numBuffers), consumer_(consumer) {
+    image_.width = width;
+    image_.height = height;
+    image_.pixels.resize(4 * width * height);
+
+    for (Buffer& buffer : buffers_) {
+        buffer.pbo = GlBuffer::create();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo.id());
+        glBufferData(GL_PIXEL_PACK_BUFFER, image_.pixels.size(), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+PixelReader::~PixelReader() {
+    for (Buffer& buffer : buffers_) {
+        if (buffer.fence != nullptr) {
+            glDeleteSync(buffer.fence);
+        }
+    }
+}
+
+void PixelReader::read() {
+    if (numPending_ == buffers_.size()) {
+        consumeOldest();
+    }
+
+    Buffer& buffer = buffers_[next_];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo.id());
+    // With a pack buffer bound the pixels go into it and the call returns without waiting for rendering to finish.
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    next_ = (next_ + 1) % buffers_.size();
+    ++numPending_;
+}
+
+void PixelReader::finish() {
+    while (numPending_ > 0) {
+        consumeOldest();
+    }
+}
+
+void PixelReader::consumeOldest() {
+    Buffer& buffer = buffers_[(next_ + buffers_.size() - numPending_) % buffers_.size()];
+    while (glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        // Keep waiting, a software renderer may take a while.
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo.id());
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image_.pixels.size(), GL_MAP_READ_BIT);
+    if (pixels != nullptr) {
+        std::memcpy(image_.pixels.data(), pixels, image_.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        std::cerr << "Failed to map a pixel buffer." << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    --numPending_;
+
+    consumer_(image_);
+}
@@ -0,0 +1,48 @@
+#ifndef TETRIS_HEADLESS_H
+#define TETRIS_HEADLESS_H
+
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glstate.h"
+#include "image.h"
+
+// Creates an OpenGL 3.3 core context on the EGL surfaceless platform of Mesa, which needs neither a display nor a GPU:
+// without one llvmpipe renders in software. There is no default framebuffer, everything must be rendered into
+// framebuffer objects and the viewport must be set explicitly. The context lives until the process exits.
+bool createHeadlessContext();
+
+// Reads rendered frames back asynchronously through a ring of pixel buffer objects. read() only starts a copy of the
+// framebuffer into the next buffer, the pixels are mapped and handed to the consumer when the ring wraps around, so
+// the transfer of a frame overlaps with rendering of the following ones.
+class PixelReader {
+public:
+    typedef std::function<void(const Image&)> Consumer;
+
+    PixelReader(int width, int height, int numBuffers, Consumer consumer);
+    ~PixelReader();
+
+    // Starts reading the framebuffer bound for reading.
+    void read();
+    // Waits for all started reads and consumes them.
+    void finish();
+
+private:
+    struct Buffer {
+        GlBuffer pbo;
+        GLsync fence = nullptr;
+    };
+
+    int width_, height_;
+    std::vector<Buffer> buffers_;
+    size_t next_ = 0;
+    size_t numPending_ = 0;
+    Consumer consumer_;
+    Image image_;
+
+    void consumeOldest();
+};
+
+#endif  // TETRIS_HEADLESS_H
@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "image.h"
+#include "trace.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "stb_image.h"
+
+Image loadRgbaImage(const std::string& path) {
+    TraceScope scope("loadRgbaImage " + path);
+    Image image;
+    int numChannels;
+    unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &numChannels, 4);
+    if (data == nullptr) {
+        std::cerr << "Failed to load image " << path << "." << std::endl;
+        image.width = 0;
+        image.height = 0;
+        return image;
+    }
+
+    // Rows are flipped here instead of by stbi_set_flip_vertically_on_load(), which sets a global flag and would race
+    // with images decoded in other threads.
+    size_t rowSize = 4 * image.width;
+    image.pixels.resize(rowSize * image.height);
+    for (int row = 0; row < image.height; ++row) {
+        std::memcpy(image.pixel(0, image.height - 1 - row), data + row * rowSize, rowSize);
+    }
+    stbi_image_free(data);
+    return image;
+}
+
+bool writePpmImage(const std::string& path, const Image& image) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    // PPM rows go top to bottom.
+    std::vector<unsigned char> row(3 * image.width);
+    for (int y = image.height - 1; y >= 0; --y) {
+        for (int x = 0; x < image.width; ++x) {
+            const unsigned char* pixel = image.pixel(x, y);
+            row[3 * x] = pixel[0];
+            row[3 * x + 1] = pixel[1];
+            row[3 * x + 2] = pixel[2];
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+
+    bool success = std::ferror(file) == 0;
+    success = std::fclose(file) == 0 && success;
+    if (!success) {
+        std::cerr << "Failed to write " << path << "." << std::endl;
+    }
+    return success;
+}
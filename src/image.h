@@ -0,0 +1,23 @@
+#ifndef TETRIS_IMAGE_H
+#define TETRIS_IMAGE_H
+
+#include <string>
+#include <vector>
+
+// 8-bit RGBA image stored bottom row first, as OpenGL expects it.
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    unsigned char* pixel(int x, int y) { return &pixels[4 * (y * width + x)]; }
+    const unsigned char* pixel(int x, int y) const { return &pixels[4 * (y * width + x)]; }
+};
+
+// Returns an empty image if the file can't be loaded.
+Image loadRgbaImage(const std::string& path);
+
+// Writes the image as a binary PPM file, dropping the alpha channel.
+bool writePpmImage(const std::string& path, const Image& image);
+
+#endif  // TETRIS_IMAGE_H
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+#include <sys/prctl.h>
+#include <time.h>
+
+#include "pacer.h"
+
+double monotonicTime() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+static void sleepUntil(double time) {
+    timespec deadline;
+    deadline.tv_sec = static_cast<time_t>(time);
+    deadline.tv_nsec = static_cast<long>((time - deadline.tv_sec) * 1e9);
+    // Sleep again if interrupted by a signal. Other errors only mean that the caller spins for the whole wait.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+}
+
+const double FramePacer::kHistogramBinWidth_ = 1e-5;
+const int FramePacer::kHistogramNumBins_ = 1000;
+
+FramePacer::FramePacer(double period, double maxLag, double spinTime)
+    : period_(period)
+    , maxLag_(maxLag)
+    , spinTime_(spinTime)
+    , deadline_(monotonicTime())
+    , jitterHistogram_(kHistogramNumBins_ + 1, 0) {
+    // The default slack of 50 us makes the kernel delay timer wake-ups to group them together.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+}
+
+double FramePacer::wait() {
+    deadline_ += period_;
+
+    double time = monotonicTime();
+    if (time > deadline_ + maxLag_) {
+        ++numOverruns_;
+        deadline_ = time;
+        return deadline_;
+    }
+
+    if (time >= deadline_) {
+        // Catching up, the tick starts as late as the previous ones ran over.
+        ++numCatchUps_;
+        recordJitter(time - deadline_);
+        return deadline_;
+    }
+
+    if (deadline_ - time > spinTime_) {
+        sleepUntil(deadline_ - spinTime_);
+    }
+    do {
+        time = monotonicTime();
+    } while (time < deadline_);
+
+    recordJitter(time - deadline_);
+    return deadline_;
+}
+
+double FramePacer::jitterPercentile(double percent) const {
+    if (numWakeUps_ == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(std::ceil(0.01 * percent * numWakeUps_));
+    uint64_t count = 0;
+    for (int bin = 0; bin < kHistogramNumBins_; ++bin) {
+        count += jitterHistogram_[bin];
+        if (count >= rank) {
+            return (bin + 1) * kHistogramBinWidth_;
+        }
+    }
+    return maxJitter_;
+}
+
+void FramePacer::recordJitter(double jitter) {
+    int bin = std::min(static_cast<int>(jitter / kHistogramBinWidth_), kHistogramNumBins_);
+    ++jitterHistogram_[bin];
+    ++numWakeUps_;
+    maxJitter_ = std::max(maxJitter_, jitter);
+}
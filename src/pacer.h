@@ -0,0 +1,51 @@
+#ifndef TETRIS_PACER_H
+#define TETRIS_PACER_H
+
+#include <cstdint>
+#include <vector>
+
+// Seconds from the monotonic clock used for all game timings.
+double monotonicTime();
+
+// Wakes up a thread periodically at absolute deadlines. It sleeps with clock_nanosleep until shortly before a deadline
+// and spins for the rest, which makes wake-ups precise independently of the scheduler granularity. Deadlines follow
+// exactly one period apart, so if the caller falls behind it runs without waiting until it catches up. When it falls
+// behind by more than maxLag the schedule restarts from the current time instead.
+//
+// The pacer lowers the timer slack of the calling thread, so it must be created in the thread which uses it.
+class FramePacer {
+public:
+    FramePacer(double period, double maxLag, double spinTime = 3e-4);
+
+    // Waits for the next deadline and returns it.
+    double wait();
+
+    double period() const { return period_; }
+
+    // Statistics of how late the wake-ups were relative to the deadlines, in seconds. Ticks run without waiting to
+    // catch up are included and also counted separately.
+    double jitterPercentile(double percent) const;
+    double maxJitter() const { return maxJitter_; }
+    uint64_t numWakeUps() const { return numWakeUps_; }
+    uint64_t numCatchUps() const { return numCatchUps_; }
+    uint64_t numOverruns() const { return numOverruns_; }
+
+private:
+    static const double kHistogramBinWidth_;
+    static const int kHistogramNumBins_;
+
+    double period_;
+    double maxLag_;
+    double spinTime_;
+    double deadline_;
+
+    std::vector<uint64_t> jitterHistogram_;
+    double maxJitter_ = 0;
+    uint64_t numWakeUps_ = 0;
+    uint64_t numCatchUps_ = 0;
+    uint64_t numOverruns_ = 0;
+
+    void recordJitter(double jitter);
+};
+
+#endif  // TETRIS_PACER_H
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <dirent.h>
+
+#include "packer.h"
+#include "serialize.h"
+#include "trace.h"
+
+const int AtlasBuilder::kPadding_ = 1;
+
+void AtlasBuilder::build(Image& atlas, AtlasRegions& regions) const {
+    std::vector<const std::pair<std::string, const Image*>*> order;
+    int area = 0;
+    int maxWidth = 0;
+    for (const auto& entry : images_) {
+        order.push_back(&entry);
+        area += (entry.second->width + 2 * kPadding_) * (entry.second->height + 2 * kPadding_);
+        maxWidth = std::max(maxWidth, entry.second->width + 2 * kPadding_);
+    }
+
+    // Placing taller images first keeps the rows tight.
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<std::string, const Image*>* a,
+                                                    const std::pair<std::string, const Image*>* b) {
+        return a->second->height > b->second->height;
+    });
+
+    int width = 1;
+    while (width < maxWidth || width * width < area) {
+        width *= 2;
+    }
+
+    std::vector<std::pair<int, int>> positions;
+    int x = 0, y = 0, rowHeight = 0;
+    for (const auto* entry : order) {
+        int paddedWidth = entry->second->width + 2 * kPadding_;
+        if (x + paddedWidth > width) {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+        }
+        positions.emplace_back(x + kPadding_, y + kPadding_);
+        x += paddedWidth;
+        rowHeight = std::max(rowHeight, entry->second->height + 2 * kPadding_);
+    }
+
+    atlas.width = width;
+    atlas.height = y + rowHeight;
+    atlas.pixels.assign(4 * atlas.width * atlas.height, 0);
+
+    regions.clear();
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Image& image = *order[i]->second;
+        int left = positions[i].first;
+        int bottom = positions[i].second;
+
+        for (int row = -kPadding_; row < image.height + kPadding_; ++row) {
+            int sourceRow = std::min(std::max(row, 0), image.height - 1);
+            for (int col = -kPadding_; col < image.width + kPadding_; ++col) {
+                int sourceCol = std::min(std::max(col, 0), image.width - 1);
+                std::memcpy(atlas.pixel(left + col, bottom + row), image.pixel(sourceCol, sourceRow), 4);
+            }
+        }
+
+        AtlasRegion region;
+        region.width = image.width;
+        region.height = image.height;
+        region.uvRect = glm::vec4(static_cast<float>(left) / atlas.width, static_cast<float>(bottom) / atlas.height,
+                                  static_cast<float>(left + image.width) / atlas.width,
+                                  static_cast<float>(bottom + image.height) / atlas.height);
+        regions[order[i]->first] = region;
+    }
+}
+
+void buildTextureAtlas(const std::string& directory, Image& atlas, AtlasRegions& regions) {
+    TraceScope scope("buildTextureAtlas");
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        std::cerr << "Failed to open directory " << directory << "." << std::endl;
+    } else {
+        const std::string extension = ".png";
+        while (dirent* entry = readdir(dir)) {
+            std::string fileName = entry->d_name;
+            if (fileName.size() > extension.size() &&
+                fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0) {
+                names.push_back(fileName.substr(0, fileName.size() - extension.size()));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+
+    // Decoding dominates, so the files are spread over worker threads, each taking the next file until none are left.
+    std::vector<Image> images(names.size());
+    std::atomic<size_t> nextImage {0};
+    auto decode = [&]() {
+        Trace::setThreadName("image decoder");
+        for (size_t i = nextImage++; i < names.size(); i = nextImage++) {
+            images[i] = loadRgbaImage(directory + "/" + names[i] + ".png");
+        }
+    };
+    size_t numWorkers = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), names.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(decode);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    AtlasBuilder builder;
+    for (size_t i = 0; i < names.size(); ++i) {
+        builder.add(names[i], images[i]);
+    }
+    builder.build(atlas, regions);
+}
+
+void writeTextureAtlas(AssetBundleWriter& bundle, const std::string& name, const Image& atlas,
+                       const AtlasRegions& regions) {
+    BinaryWriter writer;
+    writer.write(atlas.width);
+    writer.write(atlas.height);
+    writer.write(static_cast<uint32_t>(regions.size()));
+    for (const auto& entry : regions) {
+        const AtlasRegion& region = entry.second;
+        float values[] = {region.width,    region.height,   region.uvRect.x,
+                          region.uvRect.y, region.uvRect.z, region.uvRect.w};
+        writer.writeString(entry.first);
+        writer.write(values);
+    }
+    bundle.add(name + ".index", writer.data());
+    bundle.add(name + ".rgba", atlas.pixels.data(), atlas.pixels.size());
+}
+
+bool readTextureAtlas(const AssetBundle& bundle, const std::string& name, int& width, int& height,
+                      const unsigned char*& pixels, AtlasRegions& regions) {
+    size_t indexSize = 0, pixelsSize = 0;
+    const char* index = bundle.find(name + ".index", indexSize);
+    const char* data = bundle.find(name + ".rgba", pixelsSize);
+
+    BinaryReader reader(index, index != nullptr ? indexSize : 0);
+    uint32_t numRegions = 0;
+    width = height = 0;
+    reader.read(width);
+    reader.read(height);
+    reader.read(numRegions);
+    regions.clear();
+    for (uint32_t i = 0; i < numRegions && reader.ok(); ++i) {
+        std::string regionName;
+        float values[6];
+        reader.readString(regionName);
+        reader.read(values);
+        AtlasRegion& region = regions[regionName];
+        region.width = values[0];
+        region.height = values[1];
+        region.uvRect = glm::vec4(values[2], values[3], values[4], values[5]);
+    }
+    if (index == nullptr || data == nullptr || !reader.ok() || !reader.atEnd() || width < 0 || height < 0 ||
+        pixelsSize != 4 * static_cast<size_t>(width) * height) {
+        std::cerr << "Asset bundle has no valid atlas " << name << "." << std::endl;
+        return false;
+    }
+    pixels = reinterpret_cast<const unsigned char*>(data);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef TETRIS_PACKER_H
+#define TETRIS_PACKER_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "bundle.h"
+#include "image.h"
+
+struct AtlasRegion {
+    float width, height;
+    // Texture coordinates of the bottom-left and top-right corners.
+    glm::vec4 uvRect;
+};
+
+typedef std::unordered_map<std::string, AtlasRegion> AtlasRegions;
+
+// Packs images into a single image row by row. Each image is surrounded by a 1 pixel border repeating its edge pixels,
+// so linear filtering near the edges doesn't pick up colors from the neighbors.
+class AtlasBuilder {
+public:
+    // Empty images, e.g. which failed to load, are skipped.
+    void add(const std::string& name, const Image& image) {
+        if (image.width > 0 && image.height > 0) {
+            images_.emplace_back(name, &image);
+        }
+    }
+    void build(Image& atlas, AtlasRegions& regions) const;
+
+private:
+    static const int kPadding_;
+
+    std::vector<std::pair<std::string, const Image*>> images_;
+};
+
+// Packs all PNG files from the directory into an atlas image, the regions are named by file names without the
+// extension. The files are decoded in parallel, no GL context is needed.
+void buildTextureAtlas(const std::string& directory, Image& atlas, AtlasRegions& regions);
+
+// Stores the atlas in the entries "<name>.index" and "<name>.rgba" of an asset bundle.
+void writeTextureAtlas(AssetBundleWriter& bundle, const std::string& name, const Image& atlas,
+                       const AtlasRegions& regions);
+// Finds an atlas stored by writeTextureAtlas(), the pixels point into the bundle. Returns false and reports an error if
+// it is missing or damaged.
+bool readTextureAtlas(const AssetBundle& bundle, const std::string& name, int& width, int& height,
+                      const unsigned char*& pixels, AtlasRegions& regions);
+
+#endif  // TETRIS_PACKER_H
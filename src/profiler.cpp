@@ -0,0 +1,169 @@
+#include <cctype>
+#include <iostream>
+
+#include "pacer.h"
+#include "profiler.h"
+
+const char* const RenderProfiler::kPassNames_[kNumPasses] = {
+    "layer update", "layers", "board", "sprites", "overlay", "profiler"};
+
+RenderProfiler::RenderProfiler() {
+    for (Slot& slot : slots_) {
+        glGenQueries(kNumPasses, slot.queries);
+    }
+}
+
+RenderProfiler::~RenderProfiler() {
+    for (Slot& slot : slots_) {
+        glDeleteQueries(kNumPasses, slot.queries);
+    }
+    if (csv_) {
+        std::fclose(csv_);
+    }
+}
+
+bool RenderProfiler::openCsvLog(const std::string& path) {
+    csv_ = std::fopen(path.c_str(), "w");
+    if (!csv_) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    std::fprintf(csv_, "frame,cpu_ms,draw_calls,state_changes,redundant_calls,uploaded_bytes");
+    for (const char* name : kPassNames_) {
+        std::string column = name;
+        for (char& c : column) {
+            if (c == ' ') {
+                c = '_';
+            }
+        }
+        std::fprintf(csv_, ",gpu_%s_ms", column.c_str());
+    }
+    std::fprintf(csv_, "\n");
+    return true;
+}
+
+void RenderProfiler::beginFrame() {
+    Slot& slot = slots_[currentSlot_];
+    if (slot.pending) {
+        // All slots are in flight, the GPU is more than kNumSlots_ frames behind.
+        collect(slot, true);
+    }
+
+    slot.stats = FrameStats();
+    slot.stats.frame = frame_++;
+    for (bool& issued : slot.issued) {
+        issued = false;
+    }
+    frameStart_ = monotonicTime();
+}
+
+void RenderProfiler::beginPass(RenderPass pass) {
+    Slot& slot = slots_[currentSlot_];
+    glBeginQuery(GL_TIME_ELAPSED, slot.queries[pass]);
+    slot.issued[pass] = true;
+}
+
+void RenderProfiler::endPass() {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void RenderProfiler::endFrame() {
+    Slot& slot = slots_[currentSlot_];
+    slot.stats.cpuTime = monotonicTime() - frameStart_;
+    frameGlStats_ = GlState::takeStats();
+    slot.stats.gl = frameGlStats_;
+    slot.pending = true;
+    currentSlot_ = (currentSlot_ + 1) % kNumSlots_;
+
+    // Collect finished frames in order, starting from the oldest one.
+    for (int i = 0; i < kNumSlots_; ++i) {
+        Slot& oldest = slots_[(currentSlot_ + i) % kNumSlots_];
+        if (oldest.pending && !collect(oldest, false)) {
+            break;
+        }
+    }
+}
+
+bool RenderProfiler::collect(Slot& slot, bool wait) {
+    for (int pass = 0; pass < kNumPasses; ++pass) {
+        if (!slot.issued[pass]) {
+            continue;
+        }
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(slot.queries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return false;
+            }
+        }
+    }
+
+    for (int pass = 0; pass < kNumPasses; ++pass) {
+        if (slot.issued[pass]) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(slot.queries[pass], GL_QUERY_RESULT, &nanoseconds);
+            slot.stats.gpuTime[pass] = 1e-9 * nanoseconds;
+        }
+    }
+    slot.pending = false;
+    latest_ = slot.stats;
+    if (csv_) {
+        writeCsvRow(slot.stats);
+    }
+    return true;
+}
+
+// Sums the counters of all tracked state.
+static GlState::Counter stateCalls(const GlState::Stats& stats) {
+    GlState::Counter total;
+    for (const GlState::Counter* counter : {&stats.programs, &stats.textures, &stats.vertexArrays, &stats.arrayBuffers,
+                                            &stats.uniformBuffers, &stats.framebuffers, &stats.uniforms}) {
+        total.calls += counter->calls;
+        total.redundant += counter->redundant;
+    }
+    return total;
+}
+
+void RenderProfiler::writeCsvRow(const FrameStats& stats) {
+    GlState::Counter state = stateCalls(stats.gl);
+    std::fprintf(csv_, "%llu,%.4f,%u,%u,%u,%zu", static_cast<unsigned long long>(stats.frame), 1e3 * stats.cpuTime,
+                 stats.gl.drawCalls, state.calls - state.redundant, state.redundant, stats.gl.uploadedBytes);
+    for (double time : stats.gpuTime) {
+        std::fprintf(csv_, ",%.4f", 1e3 * time);
+    }
+    std::fprintf(csv_, "\n");
+}
+
+void RenderProfiler::renderOverlay(TextRenderer& textRenderer, GLfloat x, GLfloat y, const glm::vec3& color) const {
+    GLfloat lineHeight = 1.5f * textRenderer.computeHeight("A");
+    char line[64];
+
+    std::snprintf(line, sizeof(line), "CPU %.2f MS", 1e3 * latest_.cpuTime);
+    textRenderer.render(line, x, y, color);
+    y += lineHeight;
+    std::snprintf(line, sizeof(line), "DRAWS %u", latest_.gl.drawCalls);
+    textRenderer.render(line, x, y, color);
+    y += lineHeight;
+    GlState::Counter state = stateCalls(latest_.gl);
+    std::snprintf(line, sizeof(line), "STATE %u SKIPPED %u", state.calls - state.redundant, state.redundant);
+    textRenderer.render(line, x, y, color);
+    y += lineHeight;
+    std::snprintf(line, sizeof(line), "UPLOAD %.1f KB", latest_.gl.uploadedBytes / 1024.0);
+    textRenderer.render(line, x, y, color);
+
+    double gpuTotal = 0;
+    for (int pass = 0; pass < kNumPasses; ++pass) {
+        y += lineHeight;
+        std::string name = kPassNames_[pass];
+        for (char& c : name) {
+            c = std::toupper(c);
+        }
+        std::snprintf(line, sizeof(line), "%s %.3f MS", name.c_str(), 1e3 * latest_.gpuTime[pass]);
+        textRenderer.render(line, x, y, color);
+        gpuTotal += latest_.gpuTime[pass];
+    }
+    y += lineHeight;
+    std::snprintf(line, sizeof(line), "GPU %.3f MS", 1e3 * gpuTotal);
+    textRenderer.render(line, x, y, color);
+}
@@ -0,0 +1,70 @@
+#ifndef TETRIS_PROFILER_H
+#define TETRIS_PROFILER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "glstate.h"
+#include "render.h"
+
+enum RenderPass { kPassLayerUpdate, kPassLayers, kPassBoard, kPassSprites, kPassOverlay, kPassProfiler, kNumPasses };
+
+struct FrameStats {
+    uint64_t frame = 0;
+    double cpuTime = 0;  // Seconds from the frame start until all commands were issued.
+    GlState::Stats gl;
+    double gpuTime[kNumPasses] = {};  // Seconds spent by the GPU executing each pass, zero if it wasn't rendered.
+};
+
+// Collects per-frame render statistics: counters from GlState and GPU time of each render pass measured with
+// GL_TIME_ELAPSED queries. Query results become available a few frames later, they are polled without waiting, so
+// the reported statistics lag behind the rendered frame. Passes can't be nested.
+class RenderProfiler {
+public:
+    RenderProfiler();
+    ~RenderProfiler();
+
+    // Writes the statistics of every frame to a CSV file, returns false if it can't be opened.
+    bool openCsvLog(const std::string& path);
+
+    void beginFrame();
+    void beginPass(RenderPass pass);
+    void endPass();
+    // Must be called after the last pass, before swapping buffers.
+    void endFrame();
+
+    // Counters of the frame which has just ended.
+    const GlState::Stats& frameGlStats() const { return frameGlStats_; }
+    // The most recent frame with all GPU times available.
+    const FrameStats& latest() const { return latest_; }
+
+    void renderOverlay(TextRenderer& textRenderer, GLfloat x, GLfloat y, const glm::vec3& color) const;
+
+private:
+    static const int kNumSlots_ = 4;
+    static const char* const kPassNames_[kNumPasses];
+
+    struct Slot {
+        FrameStats stats;
+        GLuint queries[kNumPasses];
+        bool issued[kNumPasses];
+        bool pending = false;
+    };
+
+    Slot slots_[kNumSlots_];
+    int currentSlot_ = 0;
+    uint64_t frame_ = 0;
+    double frameStart_ = 0;
+    GlState::Stats frameGlStats_;
+    FrameStats latest_;
+    FILE* csv_ = nullptr;
+
+    // Returns false if some query of the slot isn't finished and wait is false.
+    bool collect(Slot& slot, bool wait);
+    void writeCsvRow(const FrameStats& stats);
+};
+
+#endif  // TETRIS_PROFILER_H
@@ -1,63 +1,172 @@
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include "render.h"
 
-const char* kColoredPrimitiveVertexShader = R"glsl(
+const char* kBoardVertexShader = R"glsl(
 # version 330 core
 
-layout (location = 0) in vec2 position;
+out vec2 boardPosition;
+
 uniform mat4 projection;
+uniform vec4 boardRect;
 
 void main() {
-    gl_Position = projection * vec4(position, 0, 1);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    boardPosition = boardRect.zw * corner;
+    gl_Position = projection * vec4(boardRect.xy + boardPosition, 0, 1);
 }
-
 )glsl";
 
-const char* kColoredPrimitiveFragmentShader = R"glsl(
+const char* kBoardFragmentShader = R"glsl(
 # version 330 core
 
-uniform vec3 inColor;
+in vec2 boardPosition;
 out vec4 color;
 
+// Tile color index plus one in the lower bits, zero for empty cells. The high bit marks rows being cleared.
+uniform usampler2D cells;
+uniform sampler2D atlas;
+uniform vec4 tileUvRects[7];
+uniform float tileSize;
+uniform float tileAlpha;
+uniform vec3 backgroundColor;
+uniform vec3 gridColor;
+// Color and mix coefficient of the line clear flash.
+uniform vec4 flash;
+
 void main() {
-    color = vec4(inColor, 1);
+    ivec2 cell = ivec2(floor(boardPosition / tileSize));
+    vec2 inCell = boardPosition - tileSize * vec2(cell);
+    // Grid lines are one pixel wide at the top and left edges of each cell, the quad extends one pixel past the last
+    // cell to close the grid.
+    color = vec4(inCell.x < 1 || inCell.y < 1 ? gridColor : backgroundColor, 1);
+
+    ivec2 size = textureSize(cells, 0);
+    if (cell.x >= size.x || cell.y >= size.y) {
+        return;
+    }
+
+    uint value = texelFetch(cells, cell, 0).r;
+    uint tile = value & 0x7Fu;
+    if (tile == 0u) {
+        return;
+    }
+
+    // The atlas has no mipmaps, sampling the base level explicitly avoids derivatives in non-uniform control flow.
+    // The screen y axis points down, while the texture v axis points up.
+    vec4 rect = tileUvRects[tile - 1u];
+    vec2 texCoord = mix(rect.xy, rect.zw, vec2(inCell.x, tileSize - inCell.y) / tileSize);
+    vec4 tileColor = textureLod(atlas, texCoord, 0);
+    if ((value & 0x80u) != 0u) {
+        tileColor = mix(tileColor, vec4(flash.rgb, 1), flash.a);
+    }
+    color.rgb = mix(color.rgb, tileColor.rgb, tileColor.a * tileAlpha);
 }
+)glsl";
+
+const char* kBoardWallVertexShader = R"glsl(
+# version 330 core
+
+out vec2 boardPosition;
+flat out int board;
+flat out float tileSize;
+
+uniform mat4 projection;
+// Number of columns and rows of each board.
+uniform vec2 boardSize;
+
+layout (std140) uniform BoardRects {
+    // Top-left corner and tile size of each board, the size is BoardWallRenderer::kMaxBoards.
+    vec4 boardRects[256];
+};
 
+void main() {
+    vec4 rect = boardRects[gl_InstanceID];
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    boardPosition = (rect.z * boardSize + 1) * corner;
+    board = gl_InstanceID;
+    tileSize = rect.z;
+    gl_Position = projection * vec4(rect.xy + boardPosition, 0, 1);
+}
+)glsl";
+
+const char* kBoardWallFragmentShader = R"glsl(
+# version 330 core
+
+in vec2 boardPosition;
+flat in int board;
+flat in float tileSize;
+out vec4 color;
+
+// Tile color index plus one, zero for empty cells. Each board is in its own layer.
+uniform usampler2DArray cells;
+uniform sampler2D atlas;
+uniform vec4 tileUvRects[7];
+uniform vec3 backgroundColor;
+uniform vec3 gridColor;
+
+void main() {
+    ivec2 cell = ivec2(floor(boardPosition / tileSize));
+    vec2 inCell = boardPosition - tileSize * vec2(cell);
+    // On small boards the grid lines would cover most of the cells, so they are only drawn for large enough tiles.
+    bool grid = tileSize >= 8 && (inCell.x < 1 || inCell.y < 1);
+    color = vec4(grid ? gridColor : backgroundColor, 1);
+
+    ivec3 size = textureSize(cells, 0);
+    if (cell.x >= size.x || cell.y >= size.y) {
+        return;
+    }
+
+    uint tile = texelFetch(cells, ivec3(cell, board), 0).r;
+    if (tile == 0u) {
+        return;
+    }
+
+    vec4 rect = tileUvRects[tile - 1u];
+    vec2 texCoord = mix(rect.xy, rect.zw, vec2(inCell.x, tileSize - inCell.y) / tileSize);
+    vec4 tileColor = textureLod(atlas, texCoord, 0);
+    color.rgb = mix(color.rgb, tileColor.rgb, tileColor.a);
+}
 )glsl";
 
-const char* kTileVertexShader = R"glsl(
+const char* kSpriteVertexShader = R"glsl(
 # version 330 core
 
 layout (location = 0) in vec2 position;
-layout (location = 1) in vec2 texCoord;
+layout (location = 1) in vec4 instanceRect;
+layout (location = 2) in vec4 instanceUvRect;
+layout (location = 3) in vec4 instanceMix;
+layout (location = 4) in float instanceAlphaMultiplier;
 
 out vec2 texCoordFragment;
+flat out vec4 mixFragment;
+flat out float alphaMultiplierFragment;
 
-uniform vec2 shift;
-uniform vec2 scale = vec2(1, 1);
 uniform mat4 projection;
 
 void main() {
-    gl_Position = projection * vec4(scale * position + shift, 0, 1);
-    texCoordFragment = texCoord;
+    gl_Position = projection * vec4(instanceRect.xy + instanceRect.zw * position, 0, 1);
+    // The screen y axis points down, while the texture v axis points up.
+    texCoordFragment = mix(instanceUvRect.xy, instanceUvRect.zw, vec2(position.x, 1 - position.y));
+    mixFragment = instanceMix;
+    alphaMultiplierFragment = instanceAlphaMultiplier;
 }
 )glsl";
 
-const char* kTileFragmentShader = R"glsl(
-
+const char* kSpriteFragmentShader = R"glsl(
 # version 330 core
 
 in vec2 texCoordFragment;
+flat in vec4 mixFragment;
+flat in float alphaMultiplierFragment;
 out vec4 color;
 
 uniform sampler2D sampler;
-uniform vec3 mixColor;
-uniform float mixCoeff = 0;
-uniform float alphaMultiplier = 1;
 
 void main() {
-    color = mix(texture(sampler, texCoordFragment), vec4(mixColor, 1), mixCoeff);
-    color.a *= alphaMultiplier;
+    color = mix(texture(sampler, texCoordFragment), vec4(mixFragment.rgb, 1), mixFragment.a);
+    color.a *= alphaMultiplierFragment;
 }
 
 )glsl";
@@ -68,14 +177,17 @@ const char* kGlyphVertexShader = R"glsl(
 
 layout (location = 0) in vec2 position;
 layout (location = 1) in vec2 texCoord;
+layout (location = 2) in vec3 textColor;
 
 out vec2 texCoordFragment;
+out vec3 textColorFragment;
 
 uniform mat4 projection;
 
 void main() {
     gl_Position = projection * vec4(position, 0, 1);
     texCoordFragment = texCoord;
+    textColorFragment = textColor;
 }
 
 )glsl";
@@ -85,52 +197,108 @@ const char* kGlyphFragmentShader = R"glsl(
 #version 330 core
 
 in vec2 texCoordFragment;
+in vec3 textColorFragment;
 out vec4 color;
 
-uniform vec3 textColor;
 uniform sampler2D glyph;
 
 void main() {
-    float alpha = texture(glyph, texCoordFragment).r;
-    color = vec4(textColor, alpha);
+    // The glyph texture holds a distance field, the edge is smoothed over about one screen pixel at any scale.
+    float distance = texture(glyph, texCoordFragment).a;
+    float width = 0.7 * fwidth(distance);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    color = vec4(textColorFragment, alpha);
+}
+
+)glsl";
+
+const char* kLayerVertexShader = R"glsl(
+# version 330 core
+
+out vec2 texCoord;
+
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    texCoord = corner;
+    gl_Position = vec4(2 * corner - 1, 0, 1);
 }
+)glsl";
 
+const char* kLayerFragmentShader = R"glsl(
+# version 330 core
+
+in vec2 texCoord;
+out vec4 color;
+
+uniform sampler2D layer;
+
+void main() {
+    color = texture(layer, texCoord);
+}
 )glsl";
 
 const glm::vec3 kColorBlack(0, 0, 0);
 const glm::vec3 kColorWhite(1, 1, 1);
 
-SpriteRenderer::SpriteRenderer(const glm::mat4& projection) : shader_(kTileVertexShader, kTileFragmentShader) {
-    GLfloat vertices[] = {0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 1, 1, 1, 1, 0};
+void setDefaultBlending() {
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+SpriteRenderer::SpriteRenderer(const glm::mat4& projection, const TextureAtlas& atlas, StreamBuffer& stream)
+    : atlas_(atlas), stream_(stream), shader_(kSpriteVertexShader, kSpriteFragmentShader) {
+    GLfloat vertices[] = {0, 0, 0, 1, 1, 0, 1, 1};
 
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+    vbo_ = GlBuffer::create();
 
-    glGenVertexArrays(1, &vao_);
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    vao_ = GlVertexArray::create();
+    GlState::bindVertexArray(vao_.id());
+    GlState::bindArrayBuffer(vbo_.id());
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*) 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*) 0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*) (2 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-    glBindVertexArray(0);
+
+    for (GLuint attribute = 1; attribute <= 4; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    GlState::bindArrayBuffer(0);
+    GlState::bindVertexArray(0);
 
     shader_.use();
     shader_.setMat4("projection", projection);
 }
 
-void SpriteRenderer::render(const Texture& texture, GLfloat x, GLfloat y, GLfloat width, GLfloat height,
+void SpriteRenderer::render(const AtlasRegion& region, GLfloat x, GLfloat y, GLfloat width, GLfloat height,
                             GLfloat mixCoeff, const glm::vec3& mixColor, GLfloat alphaMultiplier) {
-    texture.bind();
+    Instance instance = {x,        y, width, height, region.uvRect, {mixColor.x, mixColor.y, mixColor.z},
+                         mixCoeff, alphaMultiplier};
+    instances_.push_back(instance);
+}
+
+void SpriteRenderer::flush() {
+    if (instances_.empty()) {
+        return;
+    }
+
+    size_t offset = stream_.write(instances_.data(), instances_.size() * sizeof(Instance));
+
+    atlas_.texture().bind();
     shader_.use();
-    shader_.setVec2("shift", glm::vec2(x, y));
-    shader_.setVec2("scale", glm::vec2(width, height));
-    shader_.setFloat("mixCoeff", mixCoeff);
-    shader_.setVec3("mixColor", mixColor);
-    shader_.setFloat("alphaMultiplier", alphaMultiplier);
-    glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GlState::bindVertexArray(vao_.id());
+    pointInstanceAttributes(offset);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances_.size());
+    GlState::countDrawCall();
+
+    instances_.clear();
+}
+
+void SpriteRenderer::pointInstanceAttributes(size_t offset) const {
+    GlState::bindArrayBuffer(stream_.id());
+    auto pointer = [offset](size_t member) { return reinterpret_cast<GLvoid*>(offset + member); };
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), pointer(offsetof(Instance, x)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), pointer(offsetof(Instance, uvRect)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), pointer(offsetof(Instance, mixColor)));
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), pointer(offsetof(Instance, alphaMultiplier)));
 }
 
 void PieceRenderer::renderShape(const Piece& piece, GLfloat x, GLfloat y, GLfloat mixCoeff, const glm::vec3& mixColor,
@@ -139,15 +307,15 @@ void PieceRenderer::renderShape(const Piece& piece, GLfloat x, GLfloat y, GLfloa
         return;
     }
 
-    Texture texture = textures_.at(piece.color());
+    const AtlasRegion& tile = tiles_.at(piece.color());
 
     int index = startRow * piece.bBoxSide();
-    auto shape = piece.shape();
+    const std::vector<TileColor>& shape = piece.shape();
     for (int row = startRow; row < piece.bBoxSide(); ++row) {
         for (int col = 0; col < piece.bBoxSide(); ++col) {
             if (shape[index] != kEmpty) {
-                spriteRenderer_.render(texture, x + col * tileSize_, y + row * tileSize_, tileSize_, tileSize_,
-                                       mixCoeff, mixColor, alphaMultiplier);
+                spriteRenderer_.render(tile, x + col * tileSize_, y + row * tileSize_, tileSize_, tileSize_, mixCoeff,
+                                       mixColor, alphaMultiplier);
             }
 
             ++index;
@@ -160,14 +328,14 @@ void PieceRenderer::renderInitialShape(const Piece& piece, GLfloat x, GLfloat y)
         return;
     }
 
-    Texture texture = textures_.at(piece.color());
+    const AtlasRegion& tile = tiles_.at(piece.color());
 
     int index = 0;
-    auto shape = piece.initialShape();
+    const std::vector<TileColor>& shape = piece.initialShape();
     for (int row = 0; row < piece.nRows(); ++row) {
         for (int col = 0; col < piece.nCols(); ++col) {
             if (shape[index] != kEmpty) {
-                spriteRenderer_.render(texture, x + col * tileSize_, y + row * tileSize_, tileSize_, tileSize_);
+                spriteRenderer_.render(tile, x + col * tileSize_, y + row * tileSize_, tileSize_, tileSize_);
             }
 
             ++index;
@@ -188,86 +356,87 @@ void PieceRenderer::renderInitialShapeCentered(const Piece& piece, GLfloat x, GL
 const glm::vec3 kBackgroundColor(0.05, 0.05, 0.05);
 const glm::vec3 kGridColor(0.2, 0.2, 0.2);
 
+const GLubyte BoardRenderer::kCellClearedBit_ = 0x80;
+// Never produced by a board, forces the first upload.
+const GLubyte BoardRenderer::kCellsNotUploaded_ = 0xFF;
+
 BoardRenderer::BoardRenderer(const glm::mat4& projection, GLfloat tileSize, GLfloat x, GLfloat y, int nRows, int nCols,
-                             const std::vector<Texture>& tileTextures, SpriteRenderer& spriteRenderer,
+                             const std::vector<AtlasRegion>& tiles, const TextureAtlas& atlas,
                              PieceRenderer& pieceRenderer, PieceRenderer& ghostRenderer)
     : tileSize_(tileSize)
     , x_(x)
     , y_(y)
     , nRows_(nRows)
     , nCols_(nCols)
-    , tileTextures_(tileTextures)
+    , atlas_(atlas)
     , pieceRenderer_(pieceRenderer)
     , ghostRenderer_(ghostRenderer)
-    , spriteRenderer_(spriteRenderer)
-    , backgroundShader_(kColoredPrimitiveVertexShader, kColoredPrimitiveFragmentShader) {
-    backgroundShader_.use();
-    backgroundShader_.setMat4("projection", projection);
-
-    GLfloat width = nCols_ * tileSize_;
-    GLfloat height = nRows_ * tileSize_;
-
-    verticesBackground_ = {x_, y_, x_, y_ + height, x_ + width, y_, x_ + width, y_ + height};
-
-    GLfloat yGrid = y_;
-    for (int row = 0; row < nRows_ + 1; ++row) {
-        verticesBackground_.push_back(x_);
-        verticesBackground_.push_back(yGrid);
-        verticesBackground_.push_back(x_ + width);
-        verticesBackground_.push_back(yGrid);
-        yGrid += tileSize_;
-    }
-
-    GLfloat xGrid = x_;
-    for (int col = 0; col < nCols_ + 1; ++col) {
-        verticesBackground_.push_back(xGrid);
-        verticesBackground_.push_back(y_);
-        verticesBackground_.push_back(xGrid);
-        verticesBackground_.push_back(y_ + height);
-        xGrid += tileSize_;
+    , shader_(kBoardVertexShader, kBoardFragmentShader)
+    , cells_(nRows * nCols, kCellsNotUploaded_)
+    , nextCells_(nRows * nCols)
+    , cellsTexture_(GL_R8UI, GL_RED_INTEGER, nCols, nRows, nullptr, GL_NEAREST)
+    , tileAlphaLocation_(shader_.uniformLocation("tileAlpha"))
+    , flashLocation_(shader_.uniformLocation("flash")) {
+    std::vector<glm::vec4> uvRects;
+    for (const AtlasRegion& tile : tiles) {
+        uvRects.push_back(tile.uvRect);
     }
 
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glGenVertexArrays(1, &vaoBackground_);
-
-    glBindVertexArray(vaoBackground_);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, verticesBackground_.size() * sizeof(GLfloat), verticesBackground_.data(),
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*) 0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-}
-
-void BoardRenderer::renderBackground() const {
-    backgroundShader_.use();
-    glBindVertexArray(vaoBackground_);
-
-    backgroundShader_.setVec3("inColor", kBackgroundColor);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    backgroundShader_.setVec3("inColor", kGridColor);
-    glDrawArrays(GL_LINES, 4, 2 * (nRows_ + nCols_ + 2));
+    shader_.use();
+    shader_.setMat4("projection", projection);
+    shader_.setVec4("boardRect", glm::vec4(x_, y_, nCols_ * tileSize_ + 1, nRows_ * tileSize_ + 1));
+    shader_.setVec4Array("tileUvRects", uvRects.data(), uvRects.size());
+    shader_.setFloat("tileSize", tileSize_);
+    shader_.setVec3("backgroundColor", kBackgroundColor);
+    shader_.setVec3("gridColor", kGridColor);
+    shader_.setInt("atlas", 0);
+    shader_.setInt("cells", 1);
+
+    // The quad corners are computed from the vertex index, but a vertex array still has to be bound to draw.
+    vao_ = GlVertexArray::create();
 }
 
-void BoardRenderer::renderTiles(const Board& board, GLfloat alphaMultiplier) const {
-    int row, col;
-    GLfloat y, x;
-    GLfloat y0 = y_;
-    GLfloat x0 = x_;
-
-    for (row = 0, y = y0; row < board.nRows; ++row, y += tileSize_) {
-        for (col = 0, x = x0; col < board.nCols; ++col, x += tileSize_) {
-            TileColor tile = board.tileAt(row, col);
-            if (tile == kEmpty) {
+void BoardRenderer::render(const Board& board, GLfloat alphaMultiplier, double linesClearPercent) {
+    for (int row = 0; row < nRows_; ++row) {
+        for (int col = 0; col < nCols_; ++col) {
+            nextCells_[row * nCols_ + col] = board.tileAt(row, col) + 1;
+        }
+    }
+    if (linesClearPercent >= 0) {
+        for (int row : board.linesToClear()) {
+            // Rows above the visible board aren't in the texture.
+            if (row < 0) {
                 continue;
             }
+            for (int col = 0; col < nCols_; ++col) {
+                nextCells_[row * nCols_ + col] |= kCellClearedBit_;
+            }
+        }
+    }
 
-            spriteRenderer_.render(tileTextures_.at(tile), x, y, tileSize_, tileSize_, 0, glm::vec3(), alphaMultiplier);
+    if (nextCells_ != cells_) {
+        cellsTexture_.update(nextCells_.data());
+        cells_.swap(nextCells_);
+    }
+
+    glm::vec4 flash(0);
+    if (linesClearPercent >= 0) {
+        double t = 0.3;
+        if (linesClearPercent < t) {
+            flash = glm::vec4(kColorWhite, 0.8f * sin(M_PI * linesClearPercent / t));
+        } else {
+            flash = glm::vec4(kBackgroundColor, (linesClearPercent - t) / (1 - t));
         }
     }
+
+    atlas_.texture().bind(0);
+    cellsTexture_.bind(1);
+    shader_.use();
+    shader_.setFloat(tileAlphaLocation_, alphaMultiplier);
+    shader_.setVec4(flashLocation_, flash);
+    GlState::bindVertexArray(vao_.id());
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GlState::countDrawCall();
 }
 
 void BoardRenderer::renderPiece(const Piece& piece, int row, int col, double lockPercent,
@@ -283,101 +452,239 @@ void BoardRenderer::renderGhost(const Piece& piece, int ghostRow, int col) const
     ghostRenderer_.renderShape(piece, x_ + col * tileSize_, y_ + ghostRow * tileSize_, 0, kColorBlack, 0.7, startRow);
 }
 
-void BoardRenderer::playLinesClearAnimation(const Board& board, double percentFinished) const {
-    double t = 0.3;
+const int BoardWallRenderer::kMaxBoards = 256;
+const GLuint BoardWallRenderer::kRectsBindingPoint_ = 0;
+const GLubyte BoardWallRenderer::kCellsNotUploaded_ = 0xFF;
 
-    glm::vec3 mixColor;
-    GLfloat mixCoeff;
+BoardWallRenderer::BoardWallRenderer(const glm::mat4& projection, int nRows, int nCols, int numBoards,
+                                     const std::vector<AtlasRegion>& tiles, const TextureAtlas& atlas)
+    : nRows_(nRows)
+    , nCols_(nCols)
+    , numBoards_(std::min(numBoards, kMaxBoards))
+    , atlas_(atlas)
+    , shader_(kBoardWallVertexShader, kBoardWallFragmentShader)
+    , cells_(numBoards_ * nRows * nCols, kCellsNotUploaded_)
+    , boardCells_(nRows * nCols)
+    , boardRects_(kMaxBoards, glm::vec4(0)) {
+    std::vector<glm::vec4> uvRects;
+    for (const AtlasRegion& tile : tiles) {
+        uvRects.push_back(tile.uvRect);
+    }
+
+    shader_.use();
+    shader_.setMat4("projection", projection);
+    shader_.setVec2("boardSize", glm::vec2(nCols_, nRows_));
+    shader_.setVec4Array("tileUvRects", uvRects.data(), uvRects.size());
+    shader_.setVec3("backgroundColor", kBackgroundColor);
+    shader_.setVec3("gridColor", kGridColor);
+    shader_.setInt("atlas", 0);
+    shader_.setInt("cells", 1);
+    shader_.bindUniformBlock("BoardRects", kRectsBindingPoint_);
+
+    cellsTexture_ = GlTexture::create();
+    GlState::bindTextureArray(cellsTexture_.id(), 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8UI, nCols_, nRows_, numBoards_, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // The whole block must be backed by the buffer even if fewer boards are drawn.
+    rectsBuffer_ = GlBuffer::create();
+    GlState::bindUniformBuffer(rectsBuffer_.id());
+    glBufferData(GL_UNIFORM_BUFFER, kMaxBoards * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kRectsBindingPoint_, rectsBuffer_.id());
+
+    vao_ = GlVertexArray::create();
+}
 
-    if (percentFinished < t) {
-        double s = sin(M_PI * percentFinished / t);
-        mixColor = kColorWhite;
-        mixCoeff = 0.8f * s;
-    } else {
-        mixColor = kBackgroundColor;
-        mixCoeff = (percentFinished - t) / (1 - t);
+void BoardWallRenderer::setBoardRect(int index, GLfloat x, GLfloat y, GLfloat tileSize) {
+    glm::vec4 rect(x, y, tileSize, 0);
+    if (boardRects_.at(index) != rect) {
+        boardRects_[index] = rect;
+        boardRectsChanged_ = true;
     }
+}
 
-    for (int row : board.linesToClear()) {
-        for (int col = 0; col < nCols_; ++col) {
-            GLfloat x = x_ + col * tileSize_;
-            GLfloat y = y_ + row * tileSize_;
-            spriteRenderer_.render(tileTextures_.at(board.tileAt(row, col)), x, y, tileSize_, tileSize_, mixCoeff,
-                                   mixColor, 1);
+void BoardWallRenderer::render(const std::vector<const Board*>& boards) {
+    int numBoards = std::min(static_cast<int>(boards.size()), numBoards_);
+    size_t boardSize = boardCells_.size();
+    GlState::bindTextureArray(cellsTexture_.id(), 1);
+    for (int index = 0; index < numBoards; ++index) {
+        const Board& board = *boards[index];
+        for (int row = 0; row < nRows_; ++row) {
+            for (int col = 0; col < nCols_; ++col) {
+                boardCells_[row * nCols_ + col] = board.tileAt(row, col) + 1;
+            }
+        }
+
+        const Piece& piece = board.piece();
+        if (piece.kind() != kNone) {
+            const std::vector<TileColor>& shape = piece.shape();
+            for (int row = 0; row < piece.bBoxSide(); ++row) {
+                int boardRow = board.pieceRow() + row;
+                for (int col = 0; col < piece.bBoxSide(); ++col) {
+                    int boardCol = board.pieceCol() + col;
+                    if (shape[row * piece.bBoxSide() + col] != kEmpty && boardRow >= 0 && boardRow < nRows_ &&
+                        boardCol >= 0 && boardCol < nCols_) {
+                        boardCells_[boardRow * nCols_ + boardCol] = piece.color() + 1;
+                    }
+                }
+            }
+        }
+
+        // Only the layers of the boards which changed are uploaded.
+        auto cached = cells_.begin() + index * boardSize;
+        if (!std::equal(boardCells_.begin(), boardCells_.end(), cached)) {
+            std::copy(boardCells_.begin(), boardCells_.end(), cached);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, nCols_, nRows_, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                            boardCells_.data());
+            GlState::countUpload(boardSize);
         }
     }
+
+    if (boardRectsChanged_) {
+        GlState::bindUniformBuffer(rectsBuffer_.id());
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, numBoards_ * sizeof(glm::vec4), boardRects_.data());
+        GlState::countUpload(numBoards_ * sizeof(glm::vec4));
+        boardRectsChanged_ = false;
+    }
+
+    atlas_.texture().bind(0);
+    shader_.use();
+    GlState::bindVertexArray(vao_.id());
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, numBoards);
+    GlState::countDrawCall();
 }
 
-TextRenderer::TextRenderer(const glm::mat4& projection, const std::vector<Glyph>& font)
-    : font_(font), shader_(kGlyphVertexShader, kGlyphFragmentShader) {
+TextRenderer::TextRenderer(const glm::mat4& projection, const Font& font, StreamBuffer& stream, GLfloat size)
+    : font_(font), stream_(stream), shader_(kGlyphVertexShader, kGlyphFragmentShader) {
+    setSize(size);
     shader_.use();
     shader_.setMat4("projection", projection);
 
-    glGenVertexArrays(1, &vao_);
-    glGenBuffers(1, &vbo_);
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, 4 * 4 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*) 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*) (2 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    vao_ = GlVertexArray::create();
+    GlState::bindVertexArray(vao_.id());
+    for (GLuint attribute = 0; attribute <= 2; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+    }
+    GlState::bindVertexArray(0);
 }
 
-void TextRenderer::render(const std::string& text, GLfloat x, GLfloat y, glm::vec3 color) const {
-    shader_.use();
-    shader_.setVec3("textColor", color);
-    glBindVertexArray(vao_);
-
+void TextRenderer::render(const std::string& text, GLfloat x, GLfloat y, const glm::vec3& color) {
     x = std::round(x);
     y = std::round(y);
 
+    GLfloat capitalBearing = font_.glyphs.at('A').bearing.y;
     for (char c : text) {
-        Glyph glyph = font_.at(c);
-
-        GLfloat xBbox = x + glyph.bearing.x;
-        GLfloat yBbox = y + (font_.at('A').bearing.y - glyph.bearing.y);
-
-        GLfloat width = glyph.texture.width;
-        GLfloat height = glyph.texture.height;
-
-        GLfloat vertices[] = {xBbox,         yBbox, 0, 0, xBbox,         yBbox + height, 0, 1,
-                              xBbox + width, yBbox, 1, 0, xBbox + width, yBbox + height, 1, 1};
-
-        glyph.texture.bind();
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-        x += glyph.advance;
+        const Glyph& glyph = font_.glyphs.at(c);
+
+        // The distance field image extends beyond the glyph by the spread.
+        GLfloat x0 = x + (glyph.bearing.x - font_.spread) * scale_;
+        GLfloat y0 = y + (capitalBearing - glyph.bearing.y - font_.spread) * scale_;
+        GLfloat x1 = x0 + glyph.imageSize.x * scale_;
+        GLfloat y1 = y0 + glyph.imageSize.y * scale_;
+        const glm::vec4& uv = glyph.uvRect;
+
+        // The screen y axis points down, while the texture v axis points up.
+        Vertex topLeft = {x0, y0, uv.x, uv.w, {color.x, color.y, color.z}};
+        Vertex bottomLeft = {x0, y1, uv.x, uv.y, {color.x, color.y, color.z}};
+        Vertex topRight = {x1, y0, uv.z, uv.w, {color.x, color.y, color.z}};
+        Vertex bottomRight = {x1, y1, uv.z, uv.y, {color.x, color.y, color.z}};
+        vertices_.push_back(topLeft);
+        vertices_.push_back(bottomLeft);
+        vertices_.push_back(topRight);
+        vertices_.push_back(topRight);
+        vertices_.push_back(bottomLeft);
+        vertices_.push_back(bottomRight);
+
+        x += glyph.advance * scale_;
     }
 }
 
 void TextRenderer::renderCentered(const std::string& text, GLfloat x, GLfloat y, GLfloat width,
-                                  const glm::vec3& color) const {
+                                  const glm::vec3& color) {
     GLfloat textWidth = computeWidth(text);
     GLfloat shift = 0.5f * (width - textWidth);
     render(text, std::round(x + shift), std::round(y), color);
 }
 
+void TextRenderer::flush() {
+    if (vertices_.empty()) {
+        return;
+    }
+
+    size_t offset = stream_.write(vertices_.data(), vertices_.size() * sizeof(Vertex));
+
+    font_.texture.bind();
+    shader_.use();
+    GlState::bindVertexArray(vao_.id());
+    pointVertexAttributes(offset);
+    glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
+    GlState::countDrawCall();
+
+    vertices_.clear();
+}
+
+void TextRenderer::pointVertexAttributes(size_t offset) const {
+    GlState::bindArrayBuffer(stream_.id());
+    auto pointer = [offset](size_t member) { return reinterpret_cast<GLvoid*>(offset + member); };
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), pointer(offsetof(Vertex, x)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), pointer(offsetof(Vertex, u)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), pointer(offsetof(Vertex, color)));
+}
+
+void TextRenderer::setSize(GLfloat size) {
+    scale_ = size / font_.glyphHeight;
+}
+
 GLint TextRenderer::computeWidth(const std::string& text) const {
-    GLint width = 0;
+    GLfloat width = 0;
     for (auto c = text.begin(); c != text.end() - 1; ++c) {
-        width += font_.at(*c).advance;
+        width += font_.glyphs.at(*c).advance;
     }
-    width += font_.at(text.back()).texture.width;
-    return width;
+    width += font_.glyphs.at(text.back()).size.x;
+    return static_cast<GLint>(std::round(width * scale_));
 }
 
 GLint TextRenderer::computeHeight(const std::string& text) const {
-    GLint height = 0;
+    GLfloat height = 0;
     for (char c : text) {
-        Glyph glyph = font_.at(c);
-        auto textureHeight = static_cast<GLint>(glyph.texture.height);
-        height = std::max(height, font_.at('H').bearing.y - glyph.bearing.y + textureHeight);
+        const Glyph& glyph = font_.glyphs.at(c);
+        height = std::max(height, font_.glyphs.at('H').bearing.y - glyph.bearing.y + glyph.size.y);
+    }
+    return static_cast<GLint>(std::round(height * scale_));
+}
+
+RenderLayer::RenderLayer(GLuint width, GLuint height)
+    : texture_(GL_RGBA, width, height, nullptr), shader_(kLayerVertexShader, kLayerFragmentShader) {
+    framebuffer_ = GlFramebuffer::create();
+    GlState::bindFramebuffer(framebuffer_.id());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_.id(), 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Render layer framebuffer is incomplete." << std::endl;
     }
-    return height;
+    GlState::bindFramebuffer(0);
+
+    // The quad corners are computed from the vertex index, but a vertex array still has to be bound to draw.
+    vao_ = GlVertexArray::create();
+}
+
+void RenderLayer::begin() {
+    previousFramebuffer_ = GlState::boundFramebuffer();
+    GlState::bindFramebuffer(framebuffer_.id());
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void RenderLayer::end() const { GlState::bindFramebuffer(previousFramebuffer_); }
+
+void RenderLayer::draw() const {
+    texture_.bind();
+    shader_.use();
+    GlState::bindVertexArray(vao_.id());
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GlState::countDrawCall();
+    setDefaultBlending();
 }
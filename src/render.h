@@ -9,28 +9,54 @@
 
 #include <glm/glm.hpp>
 
+#include "atlas.h"
+#include "stream.h"
 #include "tetris.h"
 #include "util.h"
 
 extern const glm::vec3 kColorBlack;
 extern const glm::vec3 kColorWhite;
+extern const glm::vec3 kBackgroundColor;
+extern const glm::vec3 kGridColor;
 
+// Alpha blending used for all drawing, it also accumulates coverage in the alpha channel as required by RenderLayer.
+void setDefaultBlending();
+
+// Draws sprites from a texture atlas. Sprites are collected and drawn with a single instanced call by flush(), in the
+// order they were added. The instances are written into the stream buffer.
 class SpriteRenderer {
 public:
-    explicit SpriteRenderer(const glm::mat4& projection);
+    SpriteRenderer(const glm::mat4& projection, const TextureAtlas& atlas, StreamBuffer& stream);
 
-    void render(const Texture& texture, GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLfloat mixCoeff = 0,
+    void render(const AtlasRegion& region, GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLfloat mixCoeff = 0,
                 const glm::vec3& mixColor = kColorBlack, GLfloat alphaMultiplier = 1);
+    void flush();
 
 private:
+    struct Instance {
+        GLfloat x, y, width, height;
+        glm::vec4 uvRect;
+        GLfloat mixColor[3];
+        GLfloat mixCoeff;
+        GLfloat alphaMultiplier;
+    };
+
+    const TextureAtlas& atlas_;
+    StreamBuffer& stream_;
+    std::vector<Instance> instances_;
     Shader shader_;
-    GLuint vao_ = 0;
+    GlVertexArray vao_;
+    GlBuffer vbo_;
+
+    // The instances are at a different offset in the stream buffer each time.
+    void pointInstanceAttributes(size_t offset) const;
 };
 
+// Draws pieces with tile sprites indexed by TileColor, the tiles are referenced and must outlive the renderer.
 class PieceRenderer {
 public:
-    PieceRenderer(GLfloat tileSize, const std::vector<Texture>& textures, SpriteRenderer& spriteRenderer)
-        : tileSize_(tileSize), textures_(textures), spriteRenderer_(spriteRenderer) {}
+    PieceRenderer(GLfloat tileSize, const std::vector<AtlasRegion>& tiles, SpriteRenderer& spriteRenderer)
+        : tileSize_(tileSize), tiles_(tiles), spriteRenderer_(spriteRenderer) {}
 
     void renderShape(const Piece& piece, GLfloat x, GLfloat y, GLfloat mixCoeff = 0,
                      const glm::vec3& mixColor = kColorBlack, GLfloat alphaMultiplier = 1, int startRow = 0) const;
@@ -39,52 +65,136 @@ public:
 
 private:
     GLfloat tileSize_;
-    std::vector<Texture> textures_;
+    const std::vector<AtlasRegion>& tiles_;
     SpriteRenderer& spriteRenderer_;
 };
 
+// Draws the board background, grid and settled tiles with a single fullscreen quad pass. The board tiles are kept in a
+// small integer texture, which is updated only when they change, and the fragment shader looks up the tile sprite in
+// the atlas for each cell. So the cost doesn't depend on how many tiles are on the board. The falling piece and its
+// ghost are drawn as sprites.
 class BoardRenderer {
 public:
     BoardRenderer(const glm::mat4& projection, GLfloat tileSize, GLfloat x, GLfloat y, int nRows, int nCols,
-                  const std::vector<Texture>& tileTextures, SpriteRenderer& spriteRenderer,
-                  PieceRenderer& pieceRenderer, PieceRenderer& ghostRenderer);
+                  const std::vector<AtlasRegion>& tiles, const TextureAtlas& atlas, PieceRenderer& pieceRenderer,
+                  PieceRenderer& ghostRenderer);
 
-    void renderBackground() const;
-    void renderTiles(const Board& board, GLfloat alphaMultiplier = 1) const;
+    // Draws immediately. Rows from board.linesToClear() flash when linesClearPercent isn't negative.
+    void render(const Board& board, GLfloat alphaMultiplier = 1, double linesClearPercent = -1);
     void renderPiece(const Piece& piece, int row, int col, double lockPercent, double alphaMultiplier = 1) const;
     void renderGhost(const Piece& piece, int ghostRow, int col) const;
-    void playLinesClearAnimation(const Board& board, double percentFinished) const;
 
 private:
+    static const GLubyte kCellClearedBit_;
+    static const GLubyte kCellsNotUploaded_;
+
     GLfloat tileSize_;
     GLfloat x_, y_;
     int nRows_, nCols_;
 
-    const std::vector<Texture> tileTextures_;
-
+    const TextureAtlas& atlas_;
     PieceRenderer &pieceRenderer_, ghostRenderer_;
-    SpriteRenderer& spriteRenderer_;
 
-    Shader backgroundShader_;
-    std::vector<GLfloat> verticesBackground_;
-    GLuint vaoBackground_ = 0;
+    Shader shader_;
+    // The uploaded cells and the ones of the current frame, both are kept to avoid allocating each frame.
+    std::vector<GLubyte> cells_;
+    std::vector<GLubyte> nextCells_;
+    Texture cellsTexture_;
+    GLint tileAlphaLocation_;
+    GLint flashLocation_;
+    GlVertexArray vao_;
+};
+
+// Draws many boards at once, e.g. to watch games of bots. All boards are drawn with a single instanced call, shading
+// works as in BoardRenderer: cells of the boards are kept in layers of an integer texture array, their screen positions
+// in a uniform buffer and the tile sprites come from the shared atlas. The falling piece is drawn into the cells, there
+// are no ghost, lock or line clear effects.
+class BoardWallRenderer {
+public:
+    // The size of the position array in the shader.
+    static const int kMaxBoards;
+
+    BoardWallRenderer(const glm::mat4& projection, int nRows, int nCols, int numBoards,
+                      const std::vector<AtlasRegion>& tiles, const TextureAtlas& atlas);
+
+    int numBoards() const { return numBoards_; }
+    // Sets the top-left corner and the tile size of a board on the screen.
+    void setBoardRect(int index, GLfloat x, GLfloat y, GLfloat tileSize);
+
+    // Draws immediately, there must be no more boards than given at creation.
+    void render(const std::vector<const Board*>& boards);
+
+private:
+    static const GLuint kRectsBindingPoint_;
+    static const GLubyte kCellsNotUploaded_;
+
+    int nRows_, nCols_;
+    int numBoards_;
+
+    const TextureAtlas& atlas_;
+
+    Shader shader_;
+    // Cells of all boards in the order of the texture array layers.
+    std::vector<GLubyte> cells_;
+    std::vector<GLubyte> boardCells_;
+    std::vector<glm::vec4> boardRects_;
+    bool boardRectsChanged_ = true;
+    GlTexture cellsTexture_;
+    GlBuffer rectsBuffer_;
+    GlVertexArray vao_;
 };
 
+// Draws text with glyphs from a font texture. Text is collected and drawn with a single call by flush(), so all text of
+// a frame can be drawn at once. The vertices are written into the stream buffer. The size is the pixel height the font
+// is scaled to, text of different sizes can be mixed by changing it between render() calls.
 class TextRenderer {
 public:
-    TextRenderer(const glm::mat4& projection, const std::vector<Glyph>& font);
+    TextRenderer(const glm::mat4& projection, const Font& font, StreamBuffer& stream, GLfloat size);
+
+    void setSize(GLfloat size);
 
-    void render(const std::string& text, GLfloat x, GLfloat y, glm::vec3 color) const;
-    void renderCentered(const std::string& text, GLfloat x, GLfloat y, GLfloat width, const glm::vec3& color) const;
+    void render(const std::string& text, GLfloat x, GLfloat y, const glm::vec3& color);
+    void renderCentered(const std::string& text, GLfloat x, GLfloat y, GLfloat width, const glm::vec3& color);
+    void flush();
 
     GLint computeWidth(const std::string& text) const;
     GLint computeHeight(const std::string& text) const;
 
 private:
-    std::vector<Glyph> font_;
+    struct Vertex {
+        GLfloat x, y, u, v;
+        GLfloat color[3];
+    };
+
+    const Font& font_;
+    StreamBuffer& stream_;
+    GLfloat scale_ = 1;
+    std::vector<Vertex> vertices_;
+    Shader shader_;
+    GlVertexArray vao_;
+
+    void pointVertexAttributes(size_t offset) const;
+};
+
+// Offscreen copy of content which changes rarely. Everything drawn between begin() and end() goes into a texture of the
+// framebuffer size, which is then composited over the frame with a single quad by draw(). The texture holds colors
+// with premultiplied alpha, which setDefaultBlending() produces.
+class RenderLayer {
+public:
+    RenderLayer(GLuint width, GLuint height);
+
+    // Clears the layer and directs drawing into it.
+    void begin();
+    // Directs drawing back to the framebuffer which was bound before begin().
+    void end() const;
+    void draw() const;
+
+private:
+    Texture texture_;
+    GlFramebuffer framebuffer_;
+    GLuint previousFramebuffer_ = 0;
     Shader shader_;
-    GLuint vao_ = 0;
-    GLuint vbo_ = 0;
+    GlVertexArray vao_;
 };
 
 #endif  // TETRIS_RENDER_H
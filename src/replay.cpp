@@ -0,0 +1,33 @@
+#include <iostream>
+
+#include "replay.h"
+#include "serialize.h"
+
+// Shares the container with save files, the version keeps them apart.
+static const uint32_t kReplayVersion = 0x5250;
+
+bool writeReplay(const std::string& path, const Replay& replay) {
+    BinaryWriter writer;
+    writer.writeVector(replay.initialState);
+    writer.write(replay.numSteps);
+    writer.writeVector(replay.inputs);
+    return writeStateFile(path, kReplayVersion, writer.data());
+}
+
+bool readReplay(const std::string& path, Replay& replay) {
+    std::vector<char> payload;
+    if (!readStateFile(path, kReplayVersion, payload)) {
+        std::cerr << "Failed to read replay " << path << "." << std::endl;
+        return false;
+    }
+
+    BinaryReader reader(payload.data(), payload.size());
+    reader.readVector(replay.initialState);
+    reader.read(replay.numSteps);
+    reader.readVector(replay.inputs);
+    if (!reader.ok() || !reader.atEnd()) {
+        std::cerr << "Replay " << path << " is damaged." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Input recorded by the GLFW callbacks in the main thread and applied by the simulation thread.
+struct InputEvent {
+    enum Type { kKey, kFocusLost };
+
+    Type type;
+    int key;
+    int action;
+    double time;
+};
+
+// An input applied during a recorded game. The game advances exactly by the same time step in every simulation step,
+// so the step number and the offset from its start reproduce the game time at which the input was applied exactly.
+struct RecordedInput {
+    uint64_t step;
+    double offset;
+    InputEvent event;
+};
+
+// Everything needed to simulate a recorded game again with identical results.
+struct Replay {
+    std::vector<char> initialState;  // Game state serialized at the start of the recording.
+    uint64_t numSteps = 0;
+    std::vector<RecordedInput> inputs;
+};
+
+bool writeReplay(const std::string& path, const Replay& replay);
+bool readReplay(const std::string& path, Replay& replay);
+
+#endif  // TETRIS_REPLAY_H
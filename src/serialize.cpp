@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <iostream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "serialize.h"
+
+static const char kMagic[4] = {'T', 'T', 'R', 'S'};
+
+struct StateFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+    uint32_t checksum;
+};
+
+static uint32_t computeChecksum(const char* data, size_t size) {
+    // FNV-1a, good enough to detect truncated or damaged files.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint64_t hashStrings(std::initializer_list<std::string> strings) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const std::string& string : strings) {
+        for (size_t i = 0; i <= string.size(); ++i) {
+            hash ^= static_cast<unsigned char>(string.c_str()[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+bool writeStateFile(const std::string& path, uint32_t version, const std::vector<char>& payload) {
+    StateFileHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = version;
+    header.size = payload.size();
+    header.checksum = computeChecksum(payload.data(), payload.size());
+
+    std::string tmpPath = path + ".tmp";
+    FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Failed to open " << tmpPath << " for writing." << std::endl;
+        return false;
+    }
+
+    bool success = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(payload.data(), 1, payload.size(), file) == payload.size() && std::fflush(file) == 0 &&
+                   fsync(fileno(file)) == 0;
+    success = std::fclose(file) == 0 && success;
+
+    if (!success || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write " << path << "." << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool readStateFile(const std::string& path, uint32_t version, std::vector<char>& payload) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // The header is not trusted until the checksum matches, so the payload size is checked against the file size
+    // before allocating anything.
+    struct stat status;
+    StateFileHeader header;
+    bool success = fstat(fileno(file), &status) == 0 && std::fread(&header, sizeof(header), 1, file) == 1 &&
+                   std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == version &&
+                   header.size == static_cast<uint64_t>(status.st_size) - sizeof(header);
+    if (success) {
+        payload.resize(header.size);
+        success = std::fread(payload.data(), 1, header.size, file) == header.size &&
+                  computeChecksum(payload.data(), payload.size()) == header.checksum;
+    }
+    std::fclose(file);
+
+    if (!success) {
+        std::cerr << "Ignoring incompatible or damaged " << path << "." << std::endl;
+    }
+
+    return success;
+}
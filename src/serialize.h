@@ -0,0 +1,110 @@
+#ifndef TETRIS_SERIALIZE_H
+#define TETRIS_SERIALIZE_H
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Appends values to a byte buffer in the host byte order. The save file is only meant to be read back on the same
+// machine, so no attempt is made to normalize endianness.
+class BinaryWriter {
+public:
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written.");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void writeVector(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written.");
+        write(static_cast<uint32_t>(values.size()));
+        const char* bytes = reinterpret_cast<const char*>(values.data());
+        buffer_.insert(buffer_.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void writeString(const std::string& value) {
+        write(static_cast<uint32_t>(value.size()));
+        buffer_.insert(buffer_.end(), value.begin(), value.end());
+    }
+
+    const std::vector<char>& data() const { return buffer_; }
+
+private:
+    std::vector<char> buffer_;
+};
+
+// Reads values written by BinaryWriter. A read past the end of the data puts the reader into the failed state, after
+// which all reads are no-ops, so it is enough to check ok() once after reading everything.
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be read.");
+        if (!take(sizeof(T))) {
+            return;
+        }
+        std::memcpy(&value, data_ + position_ - sizeof(T), sizeof(T));
+    }
+
+    template <typename T>
+    void readVector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be read.");
+        uint32_t size = 0;
+        read(size);
+        if (!take(size * sizeof(T))) {
+            return;
+        }
+        values.resize(size);
+        std::memcpy(values.data(), data_ + position_ - size * sizeof(T), size * sizeof(T));
+    }
+
+    void readString(std::string& value) {
+        uint32_t size = 0;
+        read(size);
+        if (!take(size)) {
+            return;
+        }
+        value.assign(data_ + position_ - size, size);
+    }
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return position_ == size_; }
+
+    // Marks the data as invalid, used when a read value doesn't pass validation.
+    void fail() { ok_ = false; }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+    bool ok_ = true;
+
+    bool take(size_t count) {
+        if (!ok_ || count > size_ - position_) {
+            ok_ = false;
+            return false;
+        }
+        position_ += count;
+        return true;
+    }
+};
+
+// 64-bit FNV-1a of the strings, each one followed by a zero byte so that different splits don't collide.
+uint64_t hashStrings(std::initializer_list<std::string> strings);
+
+// Writes a versioned and checksummed payload to a file atomically: the data goes to a temporary file which is synced
+// and then renamed over the target, so a crash in the middle never leaves a torn file behind.
+bool writeStateFile(const std::string& path, uint32_t version, const std::vector<char>& payload);
+
+// Reads a payload written by writeStateFile. Returns false if the file is missing, has a different version or is
+// corrupted.
+bool readStateFile(const std::string& path, uint32_t version, std::vector<char>& payload);
+
+#endif  // TETRIS_SERIALIZE_H
@@ -0,0 +1,15 @@
+#include "snapshot.h"
+
+void GameSnapshot::capture(GameState gameState, int startLevel, const Tetris& tetris, const Board& board) {
+    this->gameState = gameState;
+    this->startLevel = startLevel;
+    this->board = board;
+    lockPercent = tetris.lockPercent();
+    pausedForLinesClear = tetris.isPausedForLinesClear();
+    linesClearPausePercent = tetris.linesClearPausePercent();
+    level = tetris.level();
+    linesCleared = tetris.linesCleared();
+    score = tetris.score();
+    nextPiece = tetris.nextPiece();
+    heldPiece = tetris.heldPiece();
+}
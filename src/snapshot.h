@@ -0,0 +1,45 @@
+#ifndef TETRIS_SNAPSHOT_H
+#define TETRIS_SNAPSHOT_H
+
+#include "tetris.h"
+
+enum GameState { kGameStart, kGameRun, kGamePaused, kGameOver };
+
+// Everything needed to render a frame, copied from the game after each simulation step.
+struct GameSnapshot {
+    GameState gameState = kGameStart;
+    int startLevel = 1;
+
+    Board board;
+    double lockPercent = 0;
+    bool pausedForLinesClear = false;
+    double linesClearPausePercent = 0;
+
+    int level = 0;
+    int linesCleared = 0;
+    int score = 0;
+    Piece nextPiece;
+    Piece heldPiece;
+
+    explicit GameSnapshot(const Board& board) : board(board), nextPiece(kNone), heldPiece(kNone) {}
+
+    void capture(GameState gameState, int startLevel, const Tetris& tetris, const Board& board);
+};
+
+// Draws frames from snapshots, the game loop only talks to this interface. The backend is selected at startup: OpenGL,
+// software or none at all, which leaves only the cost of the simulation.
+class FrameRenderer {
+public:
+    virtual ~FrameRenderer() = default;
+
+    virtual void render(const GameSnapshot& snapshot) = 0;
+    // Completes frames which are still being processed, called after the last one.
+    virtual void finish() {}
+};
+
+class NullFrameRenderer : public FrameRenderer {
+public:
+    void render(const GameSnapshot&) override {}
+};
+
+#endif  // TETRIS_SNAPSHOT_H
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cstring>
+
+#include "stream.h"
+
+const size_t StreamBuffer::kAlignment_ = 16;
+
+StreamBuffer::StreamBuffer(size_t regionSize, int numRegions) : fences_(numRegions, nullptr) { allocate(regionSize); }
+
+StreamBuffer::~StreamBuffer() { releaseFences(); }
+
+size_t StreamBuffer::write(const void* data, size_t size) {
+    if (size > regionSize_) {
+        // The old storage is freed by GL once the GPU is done with it, so there is nothing to wait for.
+        releaseFences();
+        allocate(std::max(size, 2 * regionSize_));
+    }
+
+    size_t offset = (offset_ + kAlignment_ - 1) / kAlignment_ * kAlignment_;
+    if (offset + size > regionSize_) {
+        nextRegion();
+        offset = 0;
+    }
+    offset_ = offset + size;
+
+    size_t position = region_ * regionSize_ + offset;
+    GlState::bindArrayBuffer(buffer_.id());
+    if (mapped_ != nullptr) {
+        std::memcpy(mapped_ + position, data, size);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, position, size, data);
+    }
+    GlState::countUpload(size);
+    return position;
+}
+
+void StreamBuffer::endFrame() {
+    if (offset_ > 0) {
+        nextRegion();
+    }
+}
+
+void StreamBuffer::allocate(size_t regionSize) {
+    regionSize_ = regionSize;
+    region_ = 0;
+    offset_ = 0;
+
+    buffer_ = GlBuffer::create();
+    GlState::bindArrayBuffer(buffer_.id());
+    size_t size = regionSize_ * fences_.size();
+    if (GLEW_ARB_buffer_storage) {
+        // Coherent mapping makes the writes visible to the GPU without explicit flushes.
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mapped_ = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        mapped_ = nullptr;
+    }
+}
+
+void StreamBuffer::nextRegion() {
+    if (mapped_ != nullptr) {
+        fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    region_ = (region_ + 1) % fences_.size();
+    offset_ = 0;
+
+    if (mapped_ != nullptr) {
+        GLsync fence = fences_[region_];
+        if (fence != nullptr) {
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+                // Keep waiting, the GPU is more than a whole ring behind.
+            }
+            glDeleteSync(fence);
+            fences_[region_] = nullptr;
+        }
+    } else if (region_ == 0) {
+        GlState::bindArrayBuffer(buffer_.id());
+        glBufferData(GL_ARRAY_BUFFER, regionSize_ * fences_.size(), nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::releaseFences() {
+    for (GLsync& fence : fences_) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef TETRIS_STREAM_H
+#define TETRIS_STREAM_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "glstate.h"
+
+// Vertex data written anew every frame, shared by all renderers drawing dynamic geometry. The buffer is a ring of
+// regions, one per frame in flight. With ARB_buffer_storage it is mapped persistently once and data is copied straight
+// into it. A fence placed when a region is left makes sure the GPU finished reading it before it's written again, which
+// normally has long happened. Without the extension data is written with glBufferSubData and the whole buffer is
+// orphaned when the ring wraps around, so the driver hands out new storage instead of waiting.
+class StreamBuffer {
+public:
+    explicit StreamBuffer(size_t regionSize, int numRegions = 3);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    GLuint id() const { return buffer_.id(); }
+
+    // Copies the data into the buffer and returns its offset there. The draws using the data must be issued before the
+    // next write. The buffer is left bound to GL_ARRAY_BUFFER.
+    size_t write(const void* data, size_t size);
+    // Moves to the next region, called after all draws of a frame were issued.
+    void endFrame();
+
+private:
+    static const size_t kAlignment_;
+
+    GlBuffer buffer_;
+    size_t regionSize_ = 0;
+    std::vector<GLsync> fences_;
+    size_t region_ = 0;
+    size_t offset_ = 0;
+    unsigned char* mapped_ = nullptr;
+
+    void allocate(size_t regionSize);
+    void nextRegion();
+    void releaseFences();
+};
+
+#endif  // TETRIS_STREAM_H
@@ -0,0 +1,77 @@
+#ifndef TETRIS_SYNC_H
+#define TETRIS_SYNC_H
+
+#include <atomic>
+#include <cstddef>
+
+// Lock-free triple buffer passing the latest value from a single producer to a single consumer. The producer fills
+// writeBuffer() and publishes it, the consumer picks up the most recently published value with update() and reads it
+// from readBuffer(). Neither side ever waits for the other, intermediate values are dropped if the consumer is slower.
+template <typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer(const T& initial) : buffers_ {initial, initial, initial} {}
+
+    T& writeBuffer() { return buffers_[writeIndex_]; }
+
+    void publish() {
+        writeIndex_ = middle_.exchange(writeIndex_ | kFreshBit_, std::memory_order_acq_rel) & kIndexMask_;
+    }
+
+    // Returns true if a new value was published since the last call.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & kFreshBit_) == 0) {
+            return false;
+        }
+        readIndex_ = middle_.exchange(readIndex_, std::memory_order_acq_rel) & kIndexMask_;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers_[readIndex_]; }
+
+private:
+    static const int kIndexMask_ = 3;
+    static const int kFreshBit_ = 4;
+
+    T buffers_[3];
+    int writeIndex_ = 0;
+    std::atomic<int> middle_ {1};
+    int readIndex_ = 2;
+};
+
+// Lock-free bounded FIFO queue for a single producer and a single consumer thread.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    // Returns false if the queue is full.
+    bool push(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns the oldest value without removing it or nullptr if the queue is empty.
+    const T* front() const {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items_[head & (Capacity - 1)];
+    }
+
+    // Removes the oldest value, must only be called after front() returned non-null.
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    T items_[Capacity];
+    alignas(64) std::atomic<size_t> head_ {0};
+    alignas(64) std::atomic<size_t> tail_ {0};
+};
+
+#endif  // TETRIS_SYNC_H
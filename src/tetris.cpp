@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <sstream>
+
 #include "tetris.h"
+#include "events.h"
 
 const int Piece::kNumStates_ = 4;
 
@@ -141,11 +145,45 @@ const std::vector<std::pair<int, int>>& Piece::kicks(Rotation rotation) const {
     throw std::runtime_error("This line is unreachable!");
 }
 
+void Piece::save(BinaryWriter& writer) const {
+    writer.write(kind_);
+    writer.write(state_);
+}
+
+Piece Piece::load(BinaryReader& reader) {
+    PieceKind kind = kNone;
+    int state = 0;
+    reader.read(kind);
+    reader.read(state);
+    if (kind < kNone || kind > kPieceZ || state < 0 || state >= kNumStates_) {
+        reader.fail();
+        return Piece(kNone);
+    }
+
+    Piece piece(kind);
+    for (int i = 0; i < state; ++i) {
+        piece.rotate(Rotation::kRight);
+    }
+    return piece;
+}
+
 const int Board::kRowsAbove_ = 2;
 
 Board::Board(int nRows, int nCols)
     : nRows(nRows), nCols(nCols), tiles_((nRows + kRowsAbove_) * nCols, kEmpty), piece_(kNone) {}
 
+Board& Board::operator=(const Board& other) {
+    assert(nRows == other.nRows && nCols == other.nCols);
+    tiles_ = other.tiles_;
+    piece_ = other.piece_;
+    row_ = other.row_;
+    col_ = other.col_;
+    ghostRow_ = other.ghostRow_;
+    tilesAfterClear_ = other.tilesAfterClear_;
+    linesToClear_ = other.linesToClear_;
+    return *this;
+}
+
 void Board::clear() { std::fill(tiles_.begin(), tiles_.end(), kEmpty); }
 
 bool Board::frozePiece() {
@@ -318,6 +356,76 @@ void Board::findLinesToClear() {
     std::fill(tilesAfterClear_.begin(), tilesAfterClear_.begin() + linesCleared * nCols, kEmpty);
 }
 
+void Board::save(BinaryWriter& writer) const {
+    writer.write(nRows);
+    writer.write(nCols);
+    writer.writeVector(tiles_);
+    piece_.save(writer);
+    writer.write(row_);
+    writer.write(col_);
+    writer.write(ghostRow_);
+    writer.writeVector(tilesAfterClear_);
+    writer.writeVector(linesToClear_);
+}
+
+void Board::load(BinaryReader& reader) {
+    int savedRows = 0, savedCols = 0;
+    reader.read(savedRows);
+    reader.read(savedCols);
+    if (savedRows != nRows || savedCols != nCols) {
+        reader.fail();
+        return;
+    }
+
+    reader.readVector(tiles_);
+    piece_ = Piece::load(reader);
+    reader.read(row_);
+    reader.read(col_);
+    reader.read(ghostRow_);
+    reader.readVector(tilesAfterClear_);
+    reader.readVector(linesToClear_);
+
+    if (tiles_.size() != static_cast<size_t>((nRows + kRowsAbove_) * nCols) ||
+        (!linesToClear_.empty() && tilesAfterClear_.size() != tiles_.size())) {
+        reader.fail();
+        return;
+    }
+
+    // Everything read is used as an index, so values out of range are rejected rather than trusted.
+    auto isColorValid = [](TileColor color) { return color >= kEmpty && color <= kRed; };
+    if (!std::all_of(tiles_.begin(), tiles_.end(), isColorValid) ||
+        !std::all_of(tilesAfterClear_.begin(), tilesAfterClear_.end(), isColorValid)) {
+        reader.fail();
+        return;
+    }
+    for (int row : linesToClear_) {
+        if (row < -kRowsAbove_ || row >= nRows) {
+            reader.fail();
+            return;
+        }
+    }
+    if (piece_.kind() != kNone &&
+        (!isPieceInside(row_, col_, piece_) || !isPieceInside(ghostRow_, col_, piece_) || ghostRow_ < row_)) {
+        reader.fail();
+    }
+}
+
+bool Board::isPieceInside(int row, int col, const Piece& piece) const {
+    auto shape = piece.shape();
+    int index = 0;
+    for (int pieceRow = 0; pieceRow < piece.bBoxSide(); ++pieceRow) {
+        for (int pieceCol = 0; pieceCol < piece.bBoxSide(); ++pieceCol) {
+            int boardRow = row + pieceRow, boardCol = col + pieceCol;
+            if (shape[index] != kEmpty &&
+                (boardCol < 0 || boardCol >= nCols || boardRow < -kRowsAbove_ || boardRow >= nRows)) {
+                return false;
+            }
+            ++index;
+        }
+    }
+    return true;
+}
+
 const int Tetris::kLinesToClearPerLevel_ = 10;
 const int Tetris::kMaxLevel_ = 15;
 const double Tetris::kMoveDelay_ = 0.05;
@@ -349,6 +457,8 @@ static double secondsPerLineForLevel(int level) {
 void Tetris::restart(int level) {
     board_.clear();
     gameOver_ = false;
+    time_ = 0;
+    pieceIndex_ = 0;
     level_ = level;
     secondsPerLine_ = secondsPerLineForLevel(level);
     linesCleared_ = 0;
@@ -375,9 +485,11 @@ void Tetris::restart(int level) {
     spawnPiece();
 }
 
-void Tetris::update(bool softDrop, bool moveRight, bool moveLeft) {
+void Tetris::update(bool softDrop, bool moveRight, bool moveLeft, double timeStep) {
+    time_ += timeStep;
+
     if (pausedForLinesClear_) {
-        linesClearTimer_ += timeStep_;
+        linesClearTimer_ += timeStep;
 
         if (linesClearTimer_ < kPauseAfterLineClear_) {
             return;
@@ -389,12 +501,12 @@ void Tetris::update(bool softDrop, bool moveRight, bool moveLeft) {
         pausedForLinesClear_ = false;
     }
 
-    moveDownTimer_ += timeStep_;
-    moveRepeatTimer_ += timeStep_;
-    moveRepeatDelayTimer_ += timeStep_;
+    moveDownTimer_ += timeStep;
+    moveRepeatTimer_ += timeStep;
+    moveRepeatDelayTimer_ += timeStep;
 
     if (isOnGround_) {
-        lockingTimer_ += timeStep_;
+        lockingTimer_ += timeStep;
     } else {
         lockingTimer_ = 0;
     }
@@ -444,7 +556,7 @@ void Tetris::update(bool softDrop, bool moveRight, bool moveLeft) {
     double speedFactor_ = softDrop ? kSoftDropSpeedFactor_ : 1;
     if (moveDownTimer_ >= secondsPerLine_ / speedFactor_) {
         if (board_.moveVertical(1) && softDrop) {
-            score_ += level_;
+            addScore(level_, ScoreReason::kSoftDrop);
         }
         moveDownTimer_ = 0;
     }
@@ -472,7 +584,7 @@ void Tetris::hardDrop() {
     if (board_.piece().kind() == kNone) {
         return;
     }
-    score_ += 2 * level_ * board_.hardDrop();
+    addScore(2 * level_ * board_.hardDrop(), ScoreReason::kHardDrop);
     lock();
 }
 
@@ -486,6 +598,16 @@ void Tetris::hold() {
     heldPiece_ = currentPiece;
 
     canHold_ = false;
+
+    GameEvent event;
+    event.type = EventType::kHold;
+    event.piece = currentPiece;
+    emitEvent(event);
+
+    ++pieceIndex_;
+    event.type = EventType::kSpawn;
+    event.piece = board_.piece().kind();
+    emitEvent(event);
 }
 
 void Tetris::checkLock() {
@@ -506,8 +628,19 @@ void Tetris::lock() {
     isOnGround_ = false;
     canHold_ = true;
 
+    GameEvent event;
+    event.type = EventType::kLock;
+    event.piece = board_.piece().kind();
+    event.row = board_.pieceRow();
+    event.col = board_.pieceCol();
+    event.rotation = board_.piece().rotationState();
+    emitEvent(event);
+
     if (!board_.frozePiece()) {
         gameOver_ = true;
+        event = GameEvent();
+        event.type = EventType::kGameOver;
+        emitEvent(event);
         return;
     }
 
@@ -522,6 +655,13 @@ void Tetris::lock() {
 
 void Tetris::spawnPiece() {
     gameOver_ = !board_.spawnPiece(bag_[nextPiece_]);
+    ++pieceIndex_;
+
+    GameEvent event;
+    event.type = gameOver_ ? EventType::kGameOver : EventType::kSpawn;
+    event.piece = bag_[nextPiece_];
+    emitEvent(event);
+
     ++nextPiece_;
     if (nextPiece_ == kNumPieces) {
         std::copy(bag_.begin() + kNumPieces, bag_.end(), bag_.begin());
@@ -541,9 +681,126 @@ void Tetris::updateScore(int linesCleared) {
     default: assert(false);
     }
     linesCleared_ += linesCleared;
-    score_ += deltaScore * level_;
+
+    GameEvent event;
+    event.type = EventType::kLinesCleared;
+    event.lines = linesCleared;
+    emitEvent(event);
+
+    addScore(deltaScore * level_, ScoreReason::kLinesCleared);
     if (level_ < kMaxLevel_ && linesCleared_ >= kLinesToClearPerLevel_ * level_) {
         ++level_;
         secondsPerLine_ = secondsPerLineForLevel(level_);
+
+        event = GameEvent();
+        event.type = EventType::kLevelUp;
+        event.level = level_;
+        emitEvent(event);
+    }
+}
+
+void Tetris::addScore(int delta, ScoreReason reason) {
+    score_ += delta;
+    if (delta == 0) {
+        return;
+    }
+
+    GameEvent event;
+    event.type = EventType::kScore;
+    event.scoreDelta = delta;
+    event.reason = reason;
+    emitEvent(event);
+}
+
+void Tetris::emitEvent(GameEvent& event) const {
+    if (eventSink_ == nullptr) {
+        return;
+    }
+
+    event.time = time_;
+    event.pieceIndex = pieceIndex_;
+    event.score = score_;
+    event.level = level_;
+    eventSink_->onEvent(event);
+}
+
+void Tetris::save(BinaryWriter& writer) const {
+    board_.save(writer);
+
+    std::ostringstream rngState;
+    rngState << rng_;
+    writer.writeString(rngState.str());
+
+    writer.write(gameOver_);
+    writer.write(time_);
+    writer.write(pieceIndex_);
+    writer.writeVector(bag_);
+    writer.write(nextPiece_);
+    writer.write(heldPiece_);
+    writer.write(canHold_);
+    writer.write(level_);
+    writer.write(linesCleared_);
+    writer.write(score_);
+    writer.write(secondsPerLine_);
+    writer.write(moveDownTimer_);
+    writer.write(motion_);
+    writer.write(moveLeftPrev_);
+    writer.write(moveRightPrev_);
+    writer.write(moveRepeatDelayTimer_);
+    writer.write(moveRepeatTimer_);
+    writer.write(isOnGround_);
+    writer.write(lockingTimer_);
+    writer.write(nMovesWhileLocking_);
+    writer.write(pausedForLinesClear_);
+    writer.write(linesClearTimer_);
+}
+
+void Tetris::load(BinaryReader& reader) {
+    board_.load(reader);
+
+    std::string rngState;
+    reader.readString(rngState);
+    std::istringstream rngStream(rngState);
+    rngStream >> rng_;
+    if (rngStream.fail()) {
+        reader.fail();
+    }
+
+    reader.read(gameOver_);
+    reader.read(time_);
+    reader.read(pieceIndex_);
+    reader.readVector(bag_);
+    reader.read(nextPiece_);
+    reader.read(heldPiece_);
+    reader.read(canHold_);
+    reader.read(level_);
+    reader.read(linesCleared_);
+    reader.read(score_);
+    reader.read(secondsPerLine_);
+    reader.read(moveDownTimer_);
+    reader.read(motion_);
+    reader.read(moveLeftPrev_);
+    reader.read(moveRightPrev_);
+    reader.read(moveRepeatDelayTimer_);
+    reader.read(moveRepeatTimer_);
+    reader.read(isOnGround_);
+    reader.read(lockingTimer_);
+    reader.read(nMovesWhileLocking_);
+    reader.read(pausedForLinesClear_);
+    reader.read(linesClearTimer_);
+
+    if (bag_.size() != 2 * kNumPieces || nextPiece_ < 0 || nextPiece_ >= kNumPieces || heldPiece_ < kNone ||
+        heldPiece_ > kPieceZ || level_ < 1 || level_ > kMaxLevel_ || motion_ < Motion::kNone ||
+        motion_ > Motion::kLeft) {
+        reader.fail();
+        return;
+    }
+    for (PieceKind kind : bag_) {
+        if (kind < kPieceI || kind > kPieceZ) {
+            reader.fail();
+            return;
+        }
     }
+    // The stored value is only kept for compatibility, the speed always follows from the level.
+    secondsPerLine_ = secondsPerLineForLevel(level_);
 }
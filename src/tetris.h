@@ -3,12 +3,19 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 #include <random>
 #include <iostream>
 
+#include "serialize.h"
+
 const int kNumPieces = 7;
 
+class EventSink;
+struct GameEvent;
+enum class ScoreReason : uint8_t;
+
 enum TileColor { kEmpty = -1, kCyan, kBlue, kOrange, kYellow, kGreen, kPurple, kRed };
 enum PieceKind { kNone = -1, kPieceI, kPieceJ, kPieceL, kPieceO, kPieceS, kPieceT, kPieceZ };
 enum class Rotation { kRight, kLeft };
@@ -23,6 +30,7 @@ public:
     int bBoxSide() const { return bBoxSide_; }
     int nRows() const { return nRows_; }
     int nCols() const { return nCols_; }
+    int rotationState() const { return state_; }
 
     const std::vector<TileColor>& shape() const { return shape_; }
     const std::vector<TileColor>& initialShape() const { return initialShape_; }
@@ -30,6 +38,9 @@ public:
     void rotate(Rotation rotation);
     const std::vector<std::pair<int, int>>& kicks(Rotation rotation) const;
 
+    void save(BinaryWriter& writer) const;
+    static Piece load(BinaryReader& reader);
+
 private:
     static const int kNumStates_;
     static const std::vector<std::vector<std::pair<int, int>>> kKicksIRight_, kKicksILeft_;
@@ -54,6 +65,10 @@ public:
     const int nRows, nCols;
 
     Board(int nRows, int nCols);
+    Board(const Board& other) = default;
+
+    // Copies the state of a board with the same dimensions.
+    Board& operator=(const Board& other);
 
     void clear();
 
@@ -73,11 +88,14 @@ public:
     void clearLines();
 
     const std::vector<int>& linesToClear() const { return linesToClear_; }
-    Piece piece() const { return piece_; }
+    const Piece& piece() const { return piece_; }
     int pieceRow() const { return row_; }
     int pieceCol() const { return col_; }
     int ghostRow() const { return ghostRow_; }
 
+    void save(BinaryWriter& writer) const;
+    void load(BinaryReader& reader);
+
 private:
     static const int kRowsAbove_;
 
@@ -94,6 +112,8 @@ private:
     void setTile(int row, int col, TileColor color);
     bool isTileFilled(int row, int col) const;
     bool isPositionPossible(int row, int col, const Piece& piece) const;
+    // Whether all tiles of the piece are within the board including the rows above it, ignoring other tiles.
+    bool isPieceInside(int row, int col, const Piece& piece) const;
     void updateGhostRow();
     void findLinesToClear();
 };
@@ -105,7 +125,12 @@ public:
     void restart(int level);
     bool isGameOver() const { return gameOver_; }
 
-    void update(bool softDrop, bool moveRight, bool moveLeft);
+    // Events are reported to the sink synchronously from the game methods, pass nullptr to disable reporting.
+    void setEventSink(EventSink* sink) { eventSink_ = sink; }
+
+    void update(bool softDrop, bool moveRight, bool moveLeft) { update(softDrop, moveRight, moveLeft, timeStep_); }
+    // Advances the game by an arbitrary time interval, allows to apply input in the middle of a time step.
+    void update(bool softDrop, bool moveRight, bool moveLeft, double timeStep);
     void rotate(Rotation rotation);
     void hardDrop();
     void hold();
@@ -120,6 +145,11 @@ public:
     Piece nextPiece() const { return Piece(bag_[nextPiece_]); }
     Piece heldPiece() const { return Piece(heldPiece_); }
 
+    // Saves and restores the complete game state including the board. If loading fails the reader is put into the
+    // failed state and the game must be restarted, as it might be partially overwritten.
+    void save(BinaryWriter& writer) const;
+    void load(BinaryReader& reader);
+
 private:
     static const int kLinesToClearPerLevel_;
     static const int kMaxLevel_;
@@ -131,10 +161,13 @@ private:
     static const double kPauseAfterLineClear_;
 
     Board& board_;
+    EventSink* eventSink_ = nullptr;
 
     bool gameOver_ = false;
 
     double timeStep_;
+    double time_;
+    uint32_t pieceIndex_;
 
     std::default_random_engine rng_;
     std::vector<PieceKind> bag_;
@@ -167,6 +200,8 @@ private:
     void lock();
     void spawnPiece();
     void updateScore(int linesCleared);
+    void addScore(int delta, ScoreReason reason);
+    void emitEvent(GameEvent& event) const;
 };
 
 #endif  // TETRIS_TETRIS_H
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "render.h"
+#include "thumbnail.h"
+
+// Converts to an 8-bit value the same way as writing to a normalized framebuffer does.
+static unsigned char toUnorm(float value) {
+    return static_cast<unsigned char>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255));
+}
+
+BoardThumbnailRenderer::BoardThumbnailRenderer(int tileSize, int nRows, int nCols, const std::vector<Image>& tiles)
+    : tileSize_(tileSize)
+    , nRows_(nRows)
+    , nCols_(nCols)
+    , gridPixel_(4)
+    , gridRow_(4 * width())
+    , rowCells_(nCols) {
+    for (int channel = 0; channel < 3; ++channel) {
+        gridPixel_[channel] = toUnorm(kGridColor[channel]);
+    }
+    gridPixel_[3] = 255;
+    for (size_t offset = 0; offset < gridRow_.size(); offset += 4) {
+        std::memcpy(&gridRow_[offset], gridPixel_.data(), 4);
+    }
+
+    cells_.assign(tiles.size() + 1, std::vector<unsigned char>(4 * tileSize * tileSize));
+    for (size_t kind = 0; kind < cells_.size(); ++kind) {
+        const Image* tile = kind == 0 ? nullptr : &tiles[kind - 1];
+        if (tile != nullptr && (tile->width == 0 || tile->height == 0)) {
+            std::cerr << "Tile image " << kind - 1 << " is empty, drawing the cell as empty." << std::endl;
+            tile = nullptr;
+        }
+
+        unsigned char* pixel = cells_[kind].data();
+        for (int y = 0; y < tileSize; ++y) {
+            for (int x = 0; x < tileSize; ++x, pixel += 4) {
+                // Grid lines are one pixel wide at the top and left edges of each cell.
+                const glm::vec3& base = x == 0 || y == 0 ? kGridColor : kBackgroundColor;
+                glm::vec3 color = base;
+                if (tile != nullptr) {
+                    // Images are stored bottom row first, while cell rows go from the top.
+                    int tileX = x * tile->width / tileSize;
+                    int tileY = tile->height - 1 - y * tile->height / tileSize;
+                    const unsigned char* tilePixel = tile->pixel(tileX, tileY);
+                    glm::vec3 tileColor(tilePixel[0] / 255.0f, tilePixel[1] / 255.0f, tilePixel[2] / 255.0f);
+                    color = glm::mix(base, tileColor, tilePixel[3] / 255.0f);
+                }
+                pixel[0] = toUnorm(color.r);
+                pixel[1] = toUnorm(color.g);
+                pixel[2] = toUnorm(color.b);
+                pixel[3] = 255;
+            }
+        }
+    }
+}
+
+void BoardThumbnailRenderer::render(const Board& board, Image& image) const {
+    image.width = width();
+    image.height = height();
+    image.pixels.resize(4 * image.width * image.height);
+
+    size_t blockRowSize = 4 * tileSize_;
+    size_t imageRowSize = 4 * image.width;
+    for (int row = 0; row < nRows_; ++row) {
+        for (int col = 0; col < nCols_; ++col) {
+            rowCells_[col] = cells_[board.tileAt(row, col) + 1].data();
+        }
+
+        for (int y = 0; y < tileSize_; ++y) {
+            // The image is stored bottom row first, the bottom row is the closing grid line.
+            unsigned char* pixel = &image.pixels[(image.height - 1 - row * tileSize_ - y) * imageRowSize];
+            size_t blockOffset = y * blockRowSize;
+            for (int col = 0; col < nCols_; ++col, pixel += blockRowSize) {
+                std::memcpy(pixel, rowCells_[col] + blockOffset, blockRowSize);
+            }
+            std::memcpy(pixel, gridPixel_.data(), 4);
+        }
+    }
+    std::memcpy(image.pixels.data(), gridRow_.data(), imageRowSize);
+}
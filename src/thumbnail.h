@@ -0,0 +1,59 @@
+#ifndef TETRIS_THUMBNAIL_H
+#define TETRIS_THUMBNAIL_H
+
+#include <functional>
+#include <vector>
+
+#include "image.h"
+#include "snapshot.h"
+#include "tetris.h"
+
+// Draws boards into images on the CPU, so it works without a GL context. The result is the same as of
+// BoardRenderer::render() without the line clear flash: background, grid and settled tiles, including the grid line
+// closing the board at the right and bottom. Each cell kind is composed once into a block of pixels, then drawing a
+// board is just copying rows of these blocks with memcpy, which is vectorized by the C library.
+class BoardThumbnailRenderer {
+public:
+    // Tile images are indexed by TileColor. Images of a different size than tileSize are scaled with nearest
+    // sampling, the output matches the GL renderer exactly only when they are of tileSize.
+    BoardThumbnailRenderer(int tileSize, int nRows, int nCols, const std::vector<Image>& tiles);
+
+    int width() const { return nCols_ * tileSize_ + 1; }
+    int height() const { return nRows_ * tileSize_ + 1; }
+
+    // Resizes the image if needed, so reusing the same image avoids allocations. Uses scratch space of the renderer,
+    // so one renderer must not be used by several threads at once.
+    void render(const Board& board, Image& image) const;
+
+private:
+    int tileSize_;
+    int nRows_, nCols_;
+
+    // Cell blocks stored top row first, the first one is an empty cell followed by tiles in TileColor order.
+    std::vector<std::vector<unsigned char>> cells_;
+    std::vector<unsigned char> gridPixel_;
+    std::vector<unsigned char> gridRow_;
+    // Cell blocks of the row being drawn.
+    mutable std::vector<const unsigned char*> rowCells_;
+};
+
+// Software frame renderer, draws only the board of each frame and hands the image to the consumer.
+class SoftwareFrameRenderer : public FrameRenderer {
+public:
+    typedef std::function<void(const Image&)> Consumer;
+
+    SoftwareFrameRenderer(int tileSize, int nRows, int nCols, const std::vector<Image>& tiles, Consumer consumer)
+        : boardRenderer_(tileSize, nRows, nCols, tiles), consumer_(consumer) {}
+
+    void render(const GameSnapshot& snapshot) override {
+        boardRenderer_.render(snapshot.board, image_);
+        consumer_(image_);
+    }
+
+private:
+    BoardThumbnailRenderer boardRenderer_;
+    Consumer consumer_;
+    Image image_;
+};
+
+#endif  // TETRIS_THUMBNAIL_H
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "pacer.h"
+#include "trace.h"
+
+struct TraceEvent {
+    std::string name;
+    int threadId;
+    double begin;
+    double end;
+};
+
+static std::mutex traceMutex;
+static std::vector<TraceEvent> traceEvents;
+static std::vector<std::pair<int, std::string>> threadNames;
+static double traceStart = 0;
+
+static std::atomic<int> nextThreadId {1};
+static thread_local int threadId = 0;
+
+static int currentThreadId() {
+    if (threadId == 0) {
+        threadId = nextThreadId++;
+    }
+    return threadId;
+}
+
+static void writeJsonString(FILE* file, const std::string& value) {
+    std::fputc('"', file);
+    for (char c : value) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            // Control characters, e.g. in file paths, aren't allowed in JSON strings unescaped.
+            std::fprintf(file, "\\u%04x", static_cast<unsigned char>(c));
+            continue;
+        }
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+        }
+        std::fputc(c, file);
+    }
+    std::fputc('"', file);
+}
+
+bool Trace::enabled_ = false;
+
+void Trace::addEvent(const std::string& name, double begin, double end) {
+    if (!enabled_) {
+        return;
+    }
+    int id = currentThreadId();
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.push_back({name, id, begin, end});
+}
+
+void Trace::setThreadName(const std::string& name) {
+    if (!enabled_) {
+        return;
+    }
+    int id = currentThreadId();
+    std::lock_guard<std::mutex> lock(traceMutex);
+    threadNames.emplace_back(id, name);
+}
+
+void Trace::enable() {
+    traceStart = monotonicTime();
+    enabled_ = true;
+    setThreadName("main");
+}
+
+bool Trace::write(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    // Metadata events naming the threads, then complete events with time stamps in microseconds.
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& thread : threadNames) {
+        std::fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":",
+                     first ? "" : ",\n", thread.first);
+        writeJsonString(file, thread.second);
+        std::fprintf(file, "}}");
+        first = false;
+    }
+    for (const TraceEvent& event : traceEvents) {
+        std::fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f,\"name\":",
+                     first ? "" : ",\n", event.threadId, 1e6 * (event.begin - traceStart),
+                     1e6 * (event.end - event.begin));
+        writeJsonString(file, event.name);
+        std::fprintf(file, "}");
+        first = false;
+    }
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool success = std::ferror(file) == 0;
+    success = std::fclose(file) == 0 && success;
+    if (!success) {
+        std::cerr << "Failed to write " << path << "." << std::endl;
+    }
+    return success;
+}
+
+TraceScope::TraceScope(std::string name) : name_(std::move(name)) {
+    if (Trace::isEnabled()) {
+        begin_ = monotonicTime();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (Trace::isEnabled()) {
+        Trace::addEvent(name_, begin_, monotonicTime());
+    }
+}
+
+TraceSession::TraceSession(const std::string& path) : path_(path) {
+    if (!path_.empty()) {
+        Trace::enable();
+    }
+}
+
+TraceSession::~TraceSession() {
+    if (path_.empty()) {
+        return;
+    }
+    if (shutdownBegin_ >= 0) {
+        Trace::addEvent("shutdown", shutdownBegin_, monotonicTime());
+    }
+    Trace::write(path_);
+}
+
+void TraceSession::beginShutdown() {
+    shutdownBegin_ = monotonicTime();
+}
@@ -0,0 +1,59 @@
+#ifndef TETRIS_TRACE_H
+#define TETRIS_TRACE_H
+
+#include <string>
+
+// Timeline of startup and shutdown phases written in the Chrome trace event format, which chrome://tracing and
+// Perfetto display. Recording is off unless a TraceSession with a path exists, then each scope costs two clock reads
+// and a locked append. Events can be recorded from any thread, each thread gets its own track.
+class Trace {
+public:
+    static bool isEnabled() { return enabled_; }
+
+    // Times are from monotonicTime().
+    static void addEvent(const std::string& name, double begin, double end);
+    // Names the track of the calling thread.
+    static void setThreadName(const std::string& name);
+
+private:
+    friend class TraceSession;
+
+    static bool enabled_;
+
+    static void enable();
+    static bool write(const std::string& path);
+};
+
+// Records the time between construction and destruction as an event on the track of the calling thread.
+class TraceScope {
+public:
+    explicit TraceScope(std::string name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    std::string name_;
+    double begin_ = 0;
+};
+
+// Enables recording if the path isn't empty and writes the trace when destroyed. Created first in main(), so it
+// outlives everything else and the trace covers destroying it as well.
+class TraceSession {
+public:
+    explicit TraceSession(const std::string& path);
+    ~TraceSession();
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+    // Starts the shutdown event, which lasts until the session is destroyed.
+    void beginShutdown();
+
+private:
+    std::string path_;
+    double shutdownBegin_ = -1;
+};
+
+#endif  // TETRIS_TRACE_H
@@ -1,17 +1,59 @@
+#include <algorithm>
+#include <cstdio>
 #include <string>
 #include <iostream>
 #include <vector>
 
+#include <sys/stat.h>
+
+#include "bundle.h"
+#include "image.h"
+#include "serialize.h"
+#include "trace.h"
 #include "util.h"
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
+const uint32_t Shader::kBinaryCacheVersion_ = 1;
+std::string Shader::binaryCacheDirectory_;
+
+void Shader::setBinaryCacheDirectory(const std::string& directory) {
+    binaryCacheDirectory_ = directory;
+    if (!directory.empty()) {
+        // Fails if it already exists, other failures show up when writing the files.
+        mkdir(directory.c_str(), 0755);
+    }
+}
+
+Shader::Shader(const GLchar* sourceVertex, const GLchar* sourceFragment) : program_(GlProgram::create()) {
+    TraceScope scope("Shader");
+    GLint numBinaryFormats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+    }
+    bool useCache = !binaryCacheDirectory_.empty() && numBinaryFormats > 0;
+
+    std::string driver, cachePath;
+    if (useCache) {
+        driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "\n" +
+                 reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "\n" +
+                 reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin",
+                      static_cast<unsigned long long>(hashStrings({driver, sourceVertex, sourceFragment})));
+        cachePath = binaryCacheDirectory_ + name;
+        if (loadBinary(cachePath, driver, sourceVertex, sourceFragment)) {
+            cacheUniformLocations();
+            return;
+        }
+    }
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ONLY_PNG
-#include "stb_image.h"
+    if (compile(sourceVertex, sourceFragment, useCache) && useCache) {
+        storeBinary(cachePath, driver, sourceVertex, sourceFragment);
+    }
+    cacheUniformLocations();
+}
 
-Shader::Shader(const GLchar* sourceVertex, const GLchar* sourceFragment) {
+bool Shader::compile(const GLchar* sourceVertex, const GLchar* sourceFragment, bool retrievable) {
+    TraceScope scope("compileShader");
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &sourceVertex, NULL);
     glCompileShader(vertexShader);
@@ -35,7 +77,10 @@ Shader::Shader(const GLchar* sourceVertex, const GLchar* sourceFragment) {
         std::cerr << "Error compiling fragment shader: " << infoLog << std::endl;
     }
 
-    GLuint program = glCreateProgram();
+    GLuint program = program_.id();
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
     glLinkProgram(program);
@@ -49,55 +94,182 @@ Shader::Shader(const GLchar* sourceVertex, const GLchar* sourceFragment) {
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    id_ = program;
+    return success != 0;
 }
 
-Texture loadRgbaTexture(const std::string& path) {
-    stbi_set_flip_vertically_on_load(1);
-    int width, height, numChannels;
-    GLubyte* image = stbi_load(path.c_str(), &width, &height, &numChannels, 4);
-    Texture texture(GL_RGBA, width, height, image);
-    stbi_image_free(image);
-    return texture;
-}
-
-Texture::Texture(GLenum format, GLuint width, GLuint height, GLubyte* image) : width(width), height(height) {
-    glGenTextures(1, &id_);
-    glBindTexture(GL_TEXTURE_2D, id_);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+bool Shader::loadBinary(const std::string& path, const std::string& driver, const GLchar* sourceVertex,
+                        const GLchar* sourceFragment) {
+    TraceScope scope("loadShaderBinary");
+    std::vector<char> payload;
+    if (!readStateFile(path, kBinaryCacheVersion_, payload)) {
+        return false;
+    }
+
+    // The sources and the driver are stored in full, a hash collision can't load a wrong program.
+    BinaryReader reader(payload.data(), payload.size());
+    std::string cachedDriver, cachedVertex, cachedFragment;
+    GLenum format = 0;
+    std::vector<char> binary;
+    reader.readString(cachedDriver);
+    reader.readString(cachedVertex);
+    reader.readString(cachedFragment);
+    reader.read(format);
+    reader.readVector(binary);
+    if (!reader.ok() || !reader.atEnd() || cachedDriver != driver || cachedVertex != sourceVertex ||
+        cachedFragment != sourceFragment) {
+        return false;
+    }
+
+    // The driver may still reject the binary, e.g. after an update which didn't change the version string.
+    glProgramBinary(program_.id(), format, binary.data(), binary.size());
+    GLint success = 0;
+    glGetProgramiv(program_.id(), GL_LINK_STATUS, &success);
+    return success != 0;
 }
 
-std::vector<Glyph> loadFont(const std::string& path, unsigned int glyphHeight) {
-    FT_Library ft;
-    FT_Init_FreeType(&ft);
+void Shader::storeBinary(const std::string& path, const std::string& driver, const GLchar* sourceVertex,
+                         const GLchar* sourceFragment) const {
+    GLint size = 0;
+    glGetProgramiv(program_.id(), GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
+    }
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program_.id(), size, nullptr, &format, binary.data());
 
-    FT_Face face;
-    FT_New_Face(ft, path.c_str(), 0, &face);
+    BinaryWriter writer;
+    writer.writeString(driver);
+    writer.writeString(sourceVertex);
+    writer.writeString(sourceFragment);
+    writer.write(format);
+    writer.writeVector(binary);
+    writeStateFile(path, kBinaryCacheVersion_, writer.data());
+}
 
-    FT_Set_Pixel_Sizes(face, 0, glyphHeight);
+void Shader::cacheUniformLocations() {
+    GLint numUniforms = 0, maxNameLength = 0;
+    glGetProgramiv(program_.id(), GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(program_.id(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::vector<GLchar> nameBuffer(maxNameLength + 1);
+    for (GLint index = 0; index < numUniforms; ++index) {
+        GLsizei length = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program_.id(), index, nameBuffer.size(), &length, &size, &type, nameBuffer.data());
 
-    std::vector<Glyph> glyphs;
-    for (GLubyte c = 0; c < 128; c++) {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            std::cerr << "Failed to load glyph " << c << "." << std::endl;
-            continue;
+        // Arrays are reported as "name[0]", make them accessible by the plain name as well.
+        std::string name(nameBuffer.data(), length);
+        GLint location = glGetUniformLocation(program_.id(), name.c_str());
+        uniformLocations_.emplace_back(name, location);
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            uniformLocations_.emplace_back(name.substr(0, name.size() - 3), location);
         }
+    }
+    std::sort(uniformLocations_.begin(), uniformLocations_.end());
 
-        Texture texture(GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, face->glyph->bitmap.buffer);
-        Glyph glyph = {texture, glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-                       face->glyph->advance.x >> 6};
+    GLint maxLocation = -1;
+    for (const auto& entry : uniformLocations_) {
+        maxLocation = std::max(maxLocation, entry.second);
+    }
+    uniformValues_.resize(maxLocation + 1);
+}
 
-        glyphs.push_back(glyph);
+bool Shader::updateUniformValue(GLint location, const GLfloat* values, int count) const {
+    if (location < 0 || location >= static_cast<GLint>(uniformValues_.size())) {
+        return false;
     }
 
-    // Should handle face as well.
-    FT_Done_FreeType(ft);
+    std::vector<GLfloat>& cached = uniformValues_[location];
+    bool redundant = cached.size() == static_cast<size_t>(count) && std::equal(values, values + count, cached.begin());
+    GlState::countUniformUpdate(redundant);
+    if (redundant) {
+        return false;
+    }
+    cached.assign(values, values + count);
+    return true;
+}
 
-    return glyphs;
+GLint Shader::uniformLocation(const GLchar* name) const {
+    auto it = std::lower_bound(
+        uniformLocations_.begin(), uniformLocations_.end(), name,
+        [](const std::pair<std::string, GLint>& entry, const GLchar* name) { return entry.first.compare(name) < 0; });
+    if (it == uniformLocations_.end() || it->first != name) {
+        return -1;
+    }
+    return it->second;
+}
+
+void Shader::bindUniformBlock(const GLchar* name, GLuint bindingPoint) const {
+    GLuint index = glGetUniformBlockIndex(program_.id(), name);
+    if (index == GL_INVALID_INDEX) {
+        std::cerr << "Uniform block " << name << " isn't found." << std::endl;
+        return;
+    }
+    glUniformBlockBinding(program_.id(), index, bindingPoint);
+}
+
+Texture loadRgbaTexture(const std::string& path) {
+    Image image = loadRgbaImage(path);
+    return Texture(GL_RGBA, image.width, image.height, image.pixels.data());
+}
+
+static size_t bytesPerPixel(GLenum format) {
+    switch (format) {
+    case GL_RED:
+    case GL_RED_INTEGER:
+        return 1;
+    case GL_RGB:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+Texture::Texture(GLenum format, GLuint width, GLuint height, const GLubyte* image)
+    : Texture(format, format, width, height, image, GL_LINEAR) {}
+
+Texture::Texture(GLenum internalFormat, GLenum format, GLuint width, GLuint height, const GLubyte* image,
+                 GLint filter)
+    : width(width), height(height), texture_(GlTexture::create()), format_(format) {
+    bind();
+    // Rows of single channel images aren't aligned to 4 bytes.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+}
+
+void Texture::update(const GLubyte* image) const {
+    bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format_, GL_UNSIGNED_BYTE, image);
+    GlState::countUpload(static_cast<size_t>(width) * height * bytesPerPixel(format_));
+}
+
+Font createFont(const Image& atlas, const std::vector<Glyph>& glyphs) {
+    TraceScope scope("createFont");
+    return Font {Texture(GL_RGBA, atlas.width, atlas.height, atlas.pixels.data()), glyphs, kFontGlyphHeight,
+                 kFontSpread};
+}
+
+Font loadFont(const std::string& path, const std::string& cachePath) {
+    Image atlas;
+    std::vector<Glyph> glyphs;
+    loadFontAtlas(path, cachePath, atlas, glyphs);
+    return createFont(atlas, glyphs);
+}
+
+Font loadFont(const AssetBundle& bundle, const std::string& name) {
+    TraceScope scope("loadFont " + name);
+    int width = 0, height = 0;
+    const unsigned char* pixels = nullptr;
+    std::vector<Glyph> glyphs;
+    if (!readFont(bundle, name, width, height, pixels, glyphs)) {
+        return Font {Texture(GL_RGBA, 0, 0, nullptr), std::vector<Glyph>(128), kFontGlyphHeight, kFontSpread};
+    }
+    // The pixels are uploaded straight from the mapped file.
+    return Font {Texture(GL_RGBA, width, height, pixels), glyphs, kFontGlyphHeight, kFontSpread};
 }
@@ -1,53 +1,147 @@
 #ifndef TETRIS_UTIL_H
 #define TETRIS_UTIL_H
 
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <GL/glew.h>
 #include "glm/glm.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
+#include "fontatlas.h"
+#include "glstate.h"
+
+class AssetBundle;
+
+// Owns a GL texture, move-only like all classes holding GL objects.
 class Texture {
 public:
     const GLuint width, height;
     Texture() : width(0), height(0) {};
-    Texture(GLenum format, GLuint width, GLuint height, GLubyte* image);
+    Texture(GLenum format, GLuint width, GLuint height, const GLubyte* image);
+    // Integer textures need different internal and pixel formats and can only be sampled with GL_NEAREST.
+    Texture(GLenum internalFormat, GLenum format, GLuint width, GLuint height, const GLubyte* image, GLint filter);
 
-    void bind() const { glBindTexture(GL_TEXTURE_2D, id_); }
+    GLuint id() const { return texture_.id(); }
+    void bind(GLuint unit = 0) const { GlState::bindTexture(texture_.id(), unit); }
+    // Replaces the whole image, which must have the same pixel format as the one given at creation.
+    void update(const GLubyte* image) const;
 
 private:
-    GLuint id_ = 0;
+    GlTexture texture_;
+    GLenum format_ = GL_RGBA;
 };
 
+// Shader program. Locations of all active uniforms are queried once after linking, so setting a uniform by name
+// doesn't go to the driver. Frequently set uniforms can be resolved to a location up front with uniformLocation().
+// The last value set at each location is remembered and setting the same value again is skipped. Uniforms must be set
+// while the program is in use.
+//
+// Linked programs can be cached on disk as driver specific binaries, which are loaded instead of compiling the sources
+// on later runs. Cache files are named by a hash of the driver identification and the sources.
 class Shader {
 public:
+    // Enables the binary cache in the directory, which is created if needed. An empty path disables it.
+    static void setBinaryCacheDirectory(const std::string& directory);
+
     Shader(const GLchar* sourceVertex, const GLchar* sourceFragment);
 
-    void setFloat(const GLchar* name, GLfloat value) const { glUniform1f(glGetUniformLocation(id_, name), value); }
+    // Returns -1 for unknown names, setting a uniform at this location is ignored.
+    GLint uniformLocation(const GLchar* name) const;
+    // Makes the uniform block read from the buffer bound to the binding point with glBindBufferBase.
+    void bindUniformBlock(const GLchar* name, GLuint bindingPoint) const;
 
-    void setMat4(const GLchar* name, const glm::mat4& matrix) const {
-        glUniformMatrix4fv(glGetUniformLocation(id_, name), 1, GL_FALSE, glm::value_ptr(matrix));
+    void setFloat(GLint location, GLfloat value) const {
+        if (updateUniformValue(location, &value, 1)) {
+            glUniform1f(location, value);
+        }
     }
-
-    void setVec3(const GLchar* name, glm::vec3 vec) const {
-        glUniform3f(glGetUniformLocation(id_, name), vec.x, vec.y, vec.z);
+    void setMat4(GLint location, const glm::mat4& matrix) const {
+        if (updateUniformValue(location, glm::value_ptr(matrix), 16)) {
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+        }
+    }
+    void setVec3(GLint location, glm::vec3 vec) const {
+        if (updateUniformValue(location, glm::value_ptr(vec), 3)) {
+            glUniform3f(location, vec.x, vec.y, vec.z);
+        }
+    }
+    void setVec2(GLint location, glm::vec2 vec) const {
+        if (updateUniformValue(location, glm::value_ptr(vec), 2)) {
+            glUniform2f(location, vec.x, vec.y);
+        }
+    }
+    void setVec4(GLint location, glm::vec4 vec) const {
+        if (updateUniformValue(location, glm::value_ptr(vec), 4)) {
+            glUniform4f(location, vec.x, vec.y, vec.z, vec.w);
+        }
+    }
+    // Sets count elements of an array uniform starting from the location of its first element.
+    void setVec4Array(GLint location, const glm::vec4* values, GLsizei count) const {
+        if (updateUniformValue(location, glm::value_ptr(values[0]), 4 * count)) {
+            glUniform4fv(location, count, glm::value_ptr(values[0]));
+        }
+    }
+    // Used for sampler units, the cached value is stored as a float which is exact for them.
+    void setInt(GLint location, GLint value) const {
+        GLfloat cached = value;
+        if (updateUniformValue(location, &cached, 1)) {
+            glUniform1i(location, value);
+        }
     }
 
-    void setVec2(const GLchar* name, glm::vec2 vec) const {
-        glUniform2f(glGetUniformLocation(id_, name), vec.x, vec.y);
+    void setFloat(const GLchar* name, GLfloat value) const { setFloat(uniformLocation(name), value); }
+    void setMat4(const GLchar* name, const glm::mat4& matrix) const { setMat4(uniformLocation(name), matrix); }
+    void setVec3(const GLchar* name, glm::vec3 vec) const { setVec3(uniformLocation(name), vec); }
+    void setVec2(const GLchar* name, glm::vec2 vec) const { setVec2(uniformLocation(name), vec); }
+    void setVec4(const GLchar* name, glm::vec4 vec) const { setVec4(uniformLocation(name), vec); }
+    void setVec4Array(const GLchar* name, const glm::vec4* values, GLsizei count) const {
+        setVec4Array(uniformLocation(name), values, count);
     }
+    void setInt(const GLchar* name, GLint value) const { setInt(uniformLocation(name), value); }
 
-    void use() const { glUseProgram(id_); }
+    void use() const { GlState::useProgram(program_.id()); }
 
 private:
-    GLuint id_;
+    static const uint32_t kBinaryCacheVersion_;
+    static std::string binaryCacheDirectory_;
+
+    GlProgram program_;
+    // Sorted by name.
+    std::vector<std::pair<std::string, GLint>> uniformLocations_;
+    // Indexed by location, values aren't known until set for the first time.
+    mutable std::vector<std::vector<GLfloat>> uniformValues_;
+
+    // Returns false if compiling or linking failed, the errors are printed.
+    bool compile(const GLchar* sourceVertex, const GLchar* sourceFragment, bool retrievable);
+    bool loadBinary(const std::string& path, const std::string& driver, const GLchar* sourceVertex,
+                    const GLchar* sourceFragment);
+    void storeBinary(const std::string& path, const std::string& driver, const GLchar* sourceVertex,
+                     const GLchar* sourceFragment) const;
+    void cacheUniformLocations();
+    // Returns false if the location is unknown or already holds these values.
+    bool updateUniformValue(GLint location, const GLfloat* values, int count) const;
 };
 
-struct Glyph {
+// Glyphs of ASCII characters packed into a single texture as signed distance fields: the alpha channel holds the
+// distance to the glyph outline, 0.5 on the outline and growing inside. Sampled with linear filtering, it gives sharp
+// edges at any scale, so text of every size is drawn from the same texture.
+struct Font {
     Texture texture;
-    glm::ivec2 bearing;
-    GLint64 advance;
+    std::vector<Glyph> glyphs;
+    GLfloat glyphHeight;
+    // Distance from the outline in pixels at glyphHeight, at which the field saturates.
+    GLfloat spread;
 };
 
-std::vector<Glyph> loadFont(const std::string& path, unsigned int glyphHeight);
+// Uploads the font atlas into a texture.
+Font createFont(const Image& atlas, const std::vector<Glyph>& glyphs);
+Font loadFont(const std::string& path, const std::string& cachePath);
+
+// Loads a font stored by writeFont(), its texture is uploaded without decoding anything.
+Font loadFont(const AssetBundle& bundle, const std::string& name);
 Texture loadRgbaTexture(const std::string& path);
 
 #endif  // TETRIS_UTIL_H
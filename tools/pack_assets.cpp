@@ -0,0 +1,45 @@
+// Packs the game resources into an asset bundle: all PNG images as one decoded texture atlas and the font as its
+// distance field atlas with glyph metrics. The game maps the bundle at startup and uploads the textures directly.
+//
+// Usage: pack_assets RESOURCES_DIRECTORY FONT_FILE OUTPUT_FILE
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bundle.h"
+#include "fontatlas.h"
+#include "image.h"
+#include "packer.h"
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " RESOURCES_DIRECTORY FONT_FILE OUTPUT_FILE" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string resourcesDirectory = argv[1];
+    const std::string fontPath = argv[2];
+    const std::string outputPath = argv[3];
+
+    AssetBundleWriter bundle;
+
+    Image atlas;
+    AtlasRegions regions;
+    buildTextureAtlas(resourcesDirectory, atlas, regions);
+    if (regions.empty()) {
+        std::cerr << "No images found in " << resourcesDirectory << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+    writeTextureAtlas(bundle, "atlas", atlas, regions);
+
+    Image fontAtlas;
+    std::vector<Glyph> glyphs;
+    buildFontAtlas(fontPath, fontAtlas, glyphs);
+    if (fontAtlas.width == 0) {
+        return EXIT_FAILURE;
+    }
+    writeFont(bundle, "font", fontAtlas, glyphs);
+
+    return bundle.write(outputPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+}